@@ -0,0 +1,125 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include <QDataStream>
+#include <QImage>
+#include <QTest>
+#include <QUrl>
+
+#include "../src/backends/dbus/ArgumentDecoder.h"
+
+using namespace KAuth;
+
+class ArgumentDecoderTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    ArgumentDecoderTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void testEmpty();
+    void testAccepted();
+    void testRejectedType_data();
+    void testRejectedType();
+    void testDepthLimit();
+    void testMalformed();
+
+private:
+    // What clients send to helpers without CBOR support
+    static QByteArray encode(const QVariantMap &arguments);
+    // levels lists, each one holding the next
+    static QVariant nestedLists(int levels);
+};
+
+QByteArray ArgumentDecoderTest::encode(const QVariantMap &arguments)
+{
+    QByteArray blob;
+    QDataStream stream(&blob, QIODevice::WriteOnly);
+    stream << arguments;
+    return blob;
+}
+
+QVariant ArgumentDecoderTest::nestedLists(int levels)
+{
+    QVariant value = QVariantList();
+    for (int i = 1; i < levels; ++i) {
+        value = QVariantList{value};
+    }
+    return value;
+}
+
+void ArgumentDecoderTest::testEmpty()
+{
+    QVERIFY(ArgumentDecoder::decode(QByteArray()) == QVariantMap());
+    QVERIFY(ArgumentDecoder::decode(encode(QVariantMap())) == QVariantMap());
+}
+
+void ArgumentDecoderTest::testAccepted()
+{
+    const QVariantMap arguments{
+        {QStringLiteral("int"), 42},
+        {QStringLiteral("string"), QStringLiteral("text")},
+        {QStringLiteral("url"), QUrl(QStringLiteral("https://kde.org"))},
+        {QStringLiteral("null"), QVariant(QMetaType::fromType<QString>())},
+        {QStringLiteral("list"), QVariantList{1, QStringLiteral("two"), QVariantMap{{QStringLiteral("three"), 3.0}}}},
+        {QStringLiteral("hash"), QVariantHash{{QStringLiteral("key"), QByteArray("value")}}},
+    };
+
+    const std::optional<QVariantMap> decoded = ArgumentDecoder::decode(encode(arguments));
+    QVERIFY(decoded);
+    QCOMPARE(*decoded, arguments);
+    QVERIFY(decoded->value(QStringLiteral("null")).isNull());
+}
+
+void ArgumentDecoderTest::testRejectedType_data()
+{
+    QTest::addColumn<QVariant>("value");
+
+    const QImage image(1, 1, QImage::Format_RGB32);
+    QTest::newRow("image") << QVariant(image);
+    QTest::newRow("image in list") << QVariant(QVariantList{1, image});
+    QTest::newRow("image in map") << QVariant(QVariantMap{{QStringLiteral("a"), 1}, {QStringLiteral("b"), image}});
+    QTest::newRow("image in hash") << QVariant(QVariantHash{{QStringLiteral("a"), image}});
+    QTest::newRow("image deep down") << QVariant(QVariantList{QVariantMap{{QStringLiteral("a"), QVariantList{image}}}});
+}
+
+void ArgumentDecoderTest::testRejectedType()
+{
+    QFETCH(QVariant, value);
+
+    QVERIFY(!ArgumentDecoder::decode(encode({{QStringLiteral("value"), value}})));
+}
+
+void ArgumentDecoderTest::testDepthLimit()
+{
+    // The arguments map itself doesn't count, the value in it is at depth 1
+    QVERIFY(ArgumentDecoder::decode(encode({{QStringLiteral("value"), nestedLists(32)}})));
+    QVERIFY(!ArgumentDecoder::decode(encode({{QStringLiteral("value"), nestedLists(33)}})));
+    QVERIFY(!ArgumentDecoder::decode(encode({{QStringLiteral("value"), nestedLists(1000)}})));
+}
+
+void ArgumentDecoderTest::testMalformed()
+{
+    const QByteArray valid = encode({{QStringLiteral("a"), 1}, {QStringLiteral("b"), QStringLiteral("text")}});
+    QVERIFY(ArgumentDecoder::decode(valid));
+
+    QVERIFY(!ArgumentDecoder::decode(valid + QByteArray(1, '\0')));
+    QVERIFY(!ArgumentDecoder::decode(valid + valid));
+    QVERIFY(!ArgumentDecoder::decode(valid.chopped(1)));
+    QVERIFY(!ArgumentDecoder::decode(valid.first(3)));
+
+    // Claims more entries than there are
+    QByteArray oversized = valid;
+    oversized[3] = 3;
+    QVERIFY(!ArgumentDecoder::decode(oversized));
+}
+
+QTEST_MAIN(ArgumentDecoderTest)
+#include "ArgumentDecoderTest.moc"
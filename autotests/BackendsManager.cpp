@@ -34,6 +34,8 @@ BackendsManager &BackendsManager::self()
 
 void BackendsManager::init()
 {
+    QMutexLocker locker(&mutex);
+
     if (!auth) {
         // Load the test backend
         auth = new TestBackend;
@@ -56,18 +58,27 @@ AuthBackend *BackendsManager::authBackend()
 
 HelperProxy *BackendsManager::helperProxy()
 {
-    if (!proxiesForThreads.contains(QThread::currentThread())) {
-        qDebug() << "Creating new proxy for thread" << QThread::currentThread();
-        init();
+    if (HelperProxy *proxy = proxyForCurrentThread()) {
+        return proxy;
     }
 
-    return proxiesForThreads[QThread::currentThread()];
+    qDebug() << "Creating new proxy for thread" << QThread::currentThread();
+    init();
+
+    return proxyForCurrentThread();
+}
+
+HelperProxy *BackendsManager::proxyForCurrentThread()
+{
+    QMutexLocker locker(&mutex);
+    return proxiesForThreads.value(QThread::currentThread());
 }
 
 void BackendsManager::setProxyForThread(QThread *thread, HelperProxy *proxy)
 {
     qDebug() << "Adding proxy for thread" << thread;
 
+    QMutexLocker locker(&mutex);
     proxiesForThreads.insert(thread, proxy);
 }
 
@@ -10,6 +10,8 @@
 #include "AuthBackend.h"
 #include "HelperProxy.h"
 
+#include <QMutex>
+
 namespace KAuth
 {
 class BackendsManager
@@ -25,8 +27,11 @@ public:
 
 private:
     void init();
+    HelperProxy *proxyForCurrentThread();
     AuthBackend *auth = nullptr;
     QHash<QThread *, HelperProxy *> proxiesForThreads;
+    // Threaded helper slots look up their proxy from the worker threads
+    QMutex mutex;
 };
 
 } // namespace Auth
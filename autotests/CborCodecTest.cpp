@@ -0,0 +1,230 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QDataStream>
+#include <QDateTime>
+#include <QPoint>
+#include <QTest>
+#include <QTimeZone>
+#include <QUrl>
+#include <QUuid>
+
+#include <limits>
+
+#include "../src/backends/dbus/CborCodec.h"
+
+using namespace KAuth;
+
+class CborCodecTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    CborCodecTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void testRoundTrip_data();
+    void testRoundTrip();
+    void testPackedArrays();
+    void testKeyInterning();
+    void testUnencodable();
+    void testRejected_data();
+    void testRejected();
+    void testReply();
+
+private:
+    // [version, keys, payload] tagged the way the codec does it
+    static QByteArray blob(const QCborValue &version, const QCborArray &keys, const QCborValue &payload);
+    // The payload of an encoded blob, read back without the codec
+    static QCborArray parse(const QByteArray &blob);
+};
+
+QByteArray CborCodecTest::blob(const QCborValue &version, const QCborArray &keys, const QCborValue &payload)
+{
+    return QCborValue(QCborKnownTags::Signature, QCborArray{version, keys, payload}).toCbor();
+}
+
+QCborArray CborCodecTest::parse(const QByteArray &blob)
+{
+    const QCborValue value = QCborValue::fromCbor(blob);
+    if (value.tag() != QCborKnownTags::Signature) {
+        return QCborArray();
+    }
+    return value.taggedValue().toArray();
+}
+
+void CborCodecTest::testRoundTrip_data()
+{
+    QTest::addColumn<QVariant>("value");
+
+    QTest::newRow("invalid") << QVariant();
+    QTest::newRow("bool") << QVariant(true);
+    QTest::newRow("int") << QVariant(-42);
+    QTest::newRow("uint") << QVariant(42U);
+    QTest::newRow("qlonglong") << QVariant(Q_INT64_C(-5000000000));
+    QTest::newRow("qulonglong") << QVariant(Q_UINT64_C(5000000000));
+    QTest::newRow("double") << QVariant(0.5);
+    QTest::newRow("string") << QVariant(QStringLiteral("Üñíçødé"));
+    QTest::newRow("bytes") << QVariant(QByteArray("\x00\xff", 2));
+    QTest::newRow("stringlist") << QVariant(QStringList{QStringLiteral("a"), QStringLiteral("b")});
+    QTest::newRow("url") << QVariant(QUrl(QStringLiteral("https://kde.org")));
+    QTest::newRow("datetime") << QVariant(QDateTime(QDate(2026, 1, 2), QTime(3, 4, 5), QTimeZone::UTC));
+    QTest::newRow("uuid") << QVariant(QUuid::createUuid());
+    QTest::newRow("map") << QVariant(QVariantMap{{QStringLiteral("x"), 1}, {QStringLiteral("y"), QStringLiteral("z")}});
+    QTest::newRow("mixed list") << QVariant(QVariantList{1, QStringLiteral("two"), 3.0});
+    QTest::newRow("int list") << QVariant(QVariantList{1, -2, 3});
+    QTest::newRow("double list") << QVariant(QVariantList{0.25, -1.5});
+    QTest::newRow("single int list") << QVariant(QVariantList{7});
+    QTest::newRow("empty list") << QVariant(QVariantList());
+}
+
+void CborCodecTest::testRoundTrip()
+{
+    QFETCH(QVariant, value);
+
+    const QVariantMap arguments{{QStringLiteral("value"), value}};
+    const std::optional<QByteArray> encoded = CborCodec::encodeArguments(arguments);
+    QVERIFY(encoded);
+    QVERIFY(CborCodec::isEncoded(*encoded));
+
+    const std::optional<QVariantMap> decoded = CborCodec::decodeArguments(*encoded);
+    QVERIFY(decoded);
+    QCOMPARE(decoded->value(QStringLiteral("value")).typeId(), value.typeId());
+    QCOMPARE(decoded->value(QStringLiteral("value")), value);
+}
+
+void CborCodecTest::testPackedArrays()
+{
+    const QVariantMap arguments{
+        {QStringLiteral("doubles"), QVariantList{0.5, 1.5}},
+        {QStringLiteral("ints"), QVariantList{1, 2, 3}},
+    };
+    const std::optional<QByteArray> encoded = CborCodec::encodeArguments(arguments);
+    QVERIFY(encoded);
+
+    const QCborArray array = parse(*encoded);
+    QCOMPARE(array.size(), 3);
+    QVERIFY(array.at(1).toArray() == (QCborArray{QStringLiteral("doubles"), QStringLiteral("ints")}));
+
+    // RFC 8746 float64 and sint32 little endian arrays, one byte string each
+    const QCborMap payload = array.at(2).toMap();
+    const QCborValue doubles = payload.value(0);
+    QCOMPARE(quint64(doubles.tag()), quint64(86));
+    QCOMPARE(doubles.taggedValue().toByteArray().size(), qsizetype(2 * sizeof(double)));
+    const QCborValue ints = payload.value(1);
+    QCOMPARE(quint64(ints.tag()), quint64(78));
+    QCOMPARE(ints.taggedValue().toByteArray(), QByteArray("\x01\x00\x00\x00\x02\x00\x00\x00\x03\x00\x00\x00", 12));
+
+    const std::optional<QVariantMap> decoded = CborCodec::decodeArguments(*encoded);
+    QVERIFY(decoded);
+    QCOMPARE(*decoded, arguments);
+}
+
+void CborCodecTest::testKeyInterning()
+{
+    const QVariantMap inner{{QStringLiteral("name"), 1}, {QStringLiteral("value"), 2}};
+    const QVariantMap arguments{
+        {QStringLiteral("name"), QVariantMap{{QStringLiteral("name"), inner}}},
+        {QStringLiteral("value"), QVariantList{inner, inner}},
+    };
+    const std::optional<QByteArray> encoded = CborCodec::encodeArguments(arguments);
+    QVERIFY(encoded);
+
+    // Each key is stored once, however often it is used
+    const QCborArray array = parse(*encoded);
+    QVERIFY(array.at(1).toArray() == (QCborArray{QStringLiteral("name"), QStringLiteral("value")}));
+    QCOMPARE(encoded->count("value"), 1);
+
+    const std::optional<QVariantMap> decoded = CborCodec::decodeArguments(*encoded);
+    QVERIFY(decoded);
+    QCOMPARE(*decoded, arguments);
+}
+
+void CborCodecTest::testUnencodable()
+{
+    // Left to QDataStream, which the helper checks on its own
+    QVERIFY(!CborCodec::encodeArguments({{QStringLiteral("point"), QPoint(1, 2)}}));
+    QVERIFY(!CborCodec::encodeArguments({{QStringLiteral("list"), QVariantList{1, QPoint(1, 2)}}}));
+    QVERIFY(!CborCodec::encodeArguments({{QStringLiteral("huge"), std::numeric_limits<qulonglong>::max()}}));
+    // Only UTC survives CBOR's date time strings
+    QVERIFY(!CborCodec::encodeArguments({{QStringLiteral("local"), QDateTime(QDate(2026, 1, 2), QTime(3, 4, 5), QTimeZone::LocalTime)}}));
+    QVERIFY(!CborCodec::encodeArguments({{QStringLiteral("offset"), QDateTime(QDate(2026, 1, 2), QTime(3, 4, 5), QTimeZone::fromSecondsAheadOfUtc(3600))}}));
+}
+
+void CborCodecTest::testRejected_data()
+{
+    QTest::addColumn<QByteArray>("blob");
+
+    const QByteArray valid = *CborCodec::encodeArguments({{QStringLiteral("ints"), QVariantList{1, 2, 3}}});
+    const QCborArray keys{QStringLiteral("a")};
+
+    QByteArray dataStream;
+    {
+        QDataStream stream(&dataStream, QIODevice::WriteOnly);
+        stream << QVariantMap{{QStringLiteral("a"), 1}};
+    }
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("datastream") << dataStream;
+    QTest::newRow("no signature") << QCborArray{1, keys, QCborMap{{0, 1}}}.toCbor();
+    QTest::newRow("signature only") << QByteArray("\xd9\xd9\xf7");
+    QTest::newRow("newer version") << blob(2, keys, QCborMap{{0, 1}});
+    QTest::newRow("empty keys") << blob(1, QCborArray(), QCborMap{{0, 1}});
+    QTest::newRow("key out of range") << blob(1, keys, QCborMap{{1, 1}});
+    QTest::newRow("key not a string") << blob(1, QCborArray{1}, QCborMap{{0, 1}});
+    QTest::newRow("payload not a map") << blob(1, keys, QCborArray{1});
+    QTest::newRow("short array") << QCborValue(QCborKnownTags::Signature, QCborArray{1, keys}).toCbor();
+    QTest::newRow("truncated") << valid.chopped(1);
+    QTest::newRow("trailing byte") << valid + QByteArray(1, '\0');
+    QTest::newRow("trailing item") << valid + valid;
+    QTest::newRow("int array of odd size") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(78), QByteArray(5, '\0'))}});
+    QTest::newRow("double array of odd size") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(86), QByteArray(12, '\0'))}});
+    QTest::newRow("int array not bytes") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(78), QCborArray{1, 2})}});
+    QTest::newRow("unknown tag") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(40), 1)}});
+    QTest::newRow("unknown type name") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(27), QCborArray{QStringLiteral("QPoint"), 1})}});
+    QTest::newRow("uint out of range") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(27), QCborArray{QStringLiteral("uint"), -1})}});
+    QTest::newRow("int out of range") << blob(1, keys, QCborMap{{0, Q_INT64_C(5000000000)}});
+    QTest::newRow("typed value too short") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(27), QCborArray{QStringLiteral("uint")})}});
+    QTest::newRow("string list of ints") << blob(1, keys, QCborMap{{0, QCborValue(QCborTag(27), QCborArray{QStringLiteral("QStringList"), QCborArray{1}})}});
+}
+
+void CborCodecTest::testRejected()
+{
+    QFETCH(QByteArray, blob);
+
+    QVERIFY(!CborCodec::decodeArguments(blob));
+}
+
+void CborCodecTest::testReply()
+{
+    ActionReply reply = ActionReply::HelperErrorReply(42);
+    reply.setErrorDescription(QStringLiteral("Something went wrong"));
+    reply.addData(QStringLiteral("ints"), QVariantList{1, 2});
+
+    const std::optional<QByteArray> encoded = CborCodec::encodeReply(reply);
+    QVERIFY(encoded);
+
+    const std::optional<ActionReply> decoded = CborCodec::decodeReply(*encoded);
+    QVERIFY(decoded);
+    QCOMPARE(decoded->type(), reply.type());
+    QCOMPARE(decoded->error(), 42);
+    QCOMPARE(decoded->errorDescription(), reply.errorDescription());
+    QCOMPARE(decoded->data(), reply.data());
+
+    QVERIFY(!CborCodec::decodeReply(encoded->chopped(1)));
+    QVERIFY(!CborCodec::decodeReply(*encoded + QByteArray(1, '\0')));
+    // Arguments aren't a reply
+    QVERIFY(!CborCodec::decodeReply(*CborCodec::encodeArguments({{QStringLiteral("a"), 1}})));
+}
+
+QTEST_MAIN(CborCodecTest)
+#include "CborCodecTest.moc"
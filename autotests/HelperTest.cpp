@@ -10,11 +10,25 @@
 #include <kauth/actionreply.h>
 #include <kauth/executejob.h>
 
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusUnixFileDescriptor>
+#include <QDateTime>
+#include <QImage>
+#include <QPoint>
 #include <QRandomGenerator>
 #include <QSignalSpy>
 #include <QTest>
 #include <QThread>
+#include <QTimeZone>
 #include <QTimer>
+#include <QUrl>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
 
 #include "../src/backends/dbus/DBusHelperProxy.h"
 
@@ -56,8 +70,22 @@ private Q_SLOTS:
 
     void testBasicActionExecution();
     void testExecuteJobSignals();
+    void testProgressData();
     void testTwoCalls();
+    void testConcurrentCalls();
+    void testThreadedAction();
+    void testFutureAction();
+    void testEmptyFutureAction();
+    void testStopAction();
+    void testStopDuringAuthorization();
+    void testLegacyStopAction();
+    void testCallerCredentials();
+    void testSameActionInParallel();
     void testActionData();
+    void testActionDataTypes_data();
+    void testActionDataTypes();
+    void testRejectedArguments_data();
+    void testRejectedArguments();
     void testHelperFailure();
 
     void cleanup()
@@ -189,6 +217,24 @@ void HelperTest::testExecuteJobSignals()
     QVERIFY(job->data().isEmpty());
 }
 
+void HelperTest::testProgressData()
+{
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.dataaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+
+    QSignalSpy newDataSpy(job, &KAuth::ExecuteJob::newData);
+
+    QVERIFY(job->exec());
+
+    // The first map goes out as Data signal, the second one holds a QUrl and falls back to a blob
+    QCOMPARE(newDataSpy.size(), 2);
+    QCOMPARE(newDataSpy.first().first().value<QVariantMap>().value(QLatin1String("Answer")).toInt(), 42);
+    QCOMPARE(newDataSpy.last().first().value<QVariantMap>().value(QLatin1String("Where")), QVariant(QUrl(QStringLiteral("https://kde.org"))));
+}
+
 void HelperTest::testTwoCalls()
 {
     KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.standardaction"));
@@ -203,6 +249,212 @@ void HelperTest::testTwoCalls()
     QVERIFY(job->exec());
 }
 
+void HelperTest::testConcurrentCalls()
+{
+    // Runs on a worker thread, so the main thread is free to serve other requests meanwhile.
+    // Slots on the main thread are served one after the other, see KAUTH_THREADED.
+    KAuth::Action longAction(QLatin1String("org.kde.kf6auth.autotest.threadedlongaction"));
+    longAction.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(longAction.isValid());
+
+    KAuth::ExecuteJob *longJob = longAction.execute();
+    longJob->setAutoDelete(false);
+    QSignalSpy longFinishedSpy(longJob, &KJob::result);
+    longJob->start();
+
+    // Give the long action time to get going
+    QTest::qWait(500);
+    QCOMPARE(longFinishedSpy.size(), 0);
+
+    // The helper has to serve this one while the long action is still running instead of reporting it is busy
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.standardaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QVERIFY(job->exec());
+    QVERIFY(!job->error());
+    QCOMPARE(longFinishedSpy.size(), 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(longFinishedSpy.size(), 1, 10000);
+    QVERIFY(!longJob->error());
+    delete longJob;
+}
+
+void HelperTest::testThreadedAction()
+{
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.threadedaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    action.setArguments({{QLatin1String("Answer"), 42}});
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QSignalSpy percentSpy(job, &KJob::percentChanged);
+
+    QVERIFY(job->exec());
+
+    QVERIFY(!job->error());
+    QCOMPARE(percentSpy.size(), 10);
+    QCOMPARE(job->data().value(QLatin1String("Answer")).toInt(), 42);
+    QCOMPARE(job->data().value(QLatin1String("mainThread")).toBool(), false);
+}
+
+void HelperTest::testFutureAction()
+{
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.futureaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    action.setArguments({{QLatin1String("Answer"), 42}});
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    job->setAutoDelete(false);
+    QSignalSpy finishedSpy(job, &KJob::result);
+    job->start();
+
+    // The helper is free to serve other requests while the future is pending
+    KAuth::Action otherAction(QLatin1String("org.kde.kf6auth.autotest.standardaction"));
+    otherAction.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    KAuth::ExecuteJob *otherJob = otherAction.execute();
+    QVERIFY(otherJob->exec());
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), 1, 5000);
+    QVERIFY(!job->error());
+    QCOMPARE(job->data().value(QLatin1String("Answer")).toInt(), 42);
+    delete job;
+}
+
+void HelperTest::testEmptyFutureAction()
+{
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.emptyfutureaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QVERIFY(!job->exec());
+    // HelperErrorReply(), the slot didn't pick an error code
+    QCOMPARE(job->error(), -1);
+}
+
+void HelperTest::testStopAction()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("The stop file descriptor is only available on Linux");
+#endif
+
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.stoppableaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    QSignalSpy startedSpy(BackendsManager::self().helperProxy(), &KAuth::HelperProxy::actionStarted);
+    QSignalSpy performedSpy(BackendsManager::self().helperProxy(), &KAuth::HelperProxy::actionPerformed);
+
+    KAuth::ExecuteJob *job = action.execute();
+    job->start();
+    QTRY_COMPARE(startedSpy.size(), 1);
+
+    job->kill();
+
+    // The helper answers long before its 10 seconds timeout
+    QTRY_COMPARE_WITH_TIMEOUT(performedSpy.size(), 1, 5000);
+    QCOMPARE(performedSpy.first().at(1).toString(), action.name());
+    QVERIFY(performedSpy.first().at(2).value<KAuth::ActionReply>().data().value(QLatin1String("stopped")).toBool());
+}
+
+void HelperTest::testStopDuringAuthorization()
+{
+    // The test backend takes a while to authorize this one, as if the user was asked for a password
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.longaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    QSignalSpy startedSpy(BackendsManager::self().helperProxy(), &KAuth::HelperProxy::actionStarted);
+    QSignalSpy performedSpy(BackendsManager::self().helperProxy(), &KAuth::HelperProxy::actionPerformed);
+    QSignalSpy progressSpy(BackendsManager::self().helperProxy(), &KAuth::HelperProxy::progressStep);
+
+    KAuth::ExecuteJob *job = action.execute();
+    job->start();
+    QTRY_COMPARE(startedSpy.size(), 1);
+
+    job->kill();
+
+    QTRY_COMPARE(performedSpy.size(), 1);
+    QCOMPARE(performedSpy.first().at(1).toString(), action.name());
+    QCOMPARE(performedSpy.first().at(2).value<KAuth::ActionReply>().error(), (int)KAuth::ActionReply::UserCancelledError);
+    // The slot never ran
+    QCOMPARE(progressSpy.size(), 0);
+}
+
+void HelperTest::testLegacyStopAction()
+{
+    // Clients built with an older KAuth call performAction() and stop it through the main object
+    const QString helperID = QStringLiteral("org.kde.kf6auth.autotest");
+    const QString actionName = QStringLiteral("org.kde.kf6auth.autotest.pollingaction");
+    QDBusConnection bus = QDBusConnection::sessionBus();
+
+    QDBusMessage perform = QDBusMessage::createMethodCall(helperID, QStringLiteral("/"), QStringLiteral("org.kde.kf6auth"), QStringLiteral("performAction"));
+    perform << actionName << bus.baseService().toUtf8() << QVariantMap() << QByteArray()
+            << QVariant::fromValue(QMap<QString, QDBusUnixFileDescriptor>());
+    QDBusPendingCallWatcher watcher(bus.asyncCall(perform));
+    QSignalSpy finishedSpy(&watcher, &QDBusPendingCallWatcher::finished);
+
+    // Long enough for the slot to start, it then blocks the helper's main thread
+    QTest::qWait(1000);
+    QVERIFY(!watcher.isFinished());
+
+    QDBusMessage stop = QDBusMessage::createMethodCall(helperID, QStringLiteral("/"), QStringLiteral("org.kde.kf6auth"), QStringLiteral("stopAction"));
+    stop << actionName;
+    bus.asyncCall(stop);
+
+    // The slot only gives up on its own after 10 seconds
+    QVERIFY(finishedSpy.wait(5000));
+    const QDBusPendingReply<QByteArray> reply = watcher;
+    QVERIFY(!reply.isError());
+    const KAuth::ActionReply actionReply = KAuth::ActionReply::deserialize(reply.value());
+    QCOMPARE(actionReply.type(), KAuth::ActionReply::SuccessType);
+    QVERIFY(actionReply.data().value(QLatin1String("stopped")).toBool());
+}
+
+void HelperTest::testCallerCredentials()
+{
+    // The helper runs in this very process in the tests
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.credentialsaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QVERIFY(job->exec());
+
+    QVERIFY(!job->error());
+    QCOMPARE(job->data().value(QLatin1String("pid")).toLongLong(), QCoreApplication::applicationPid());
+#ifdef Q_OS_UNIX
+    QCOMPARE(job->data().value(QLatin1String("uid")).toInt(), int(getuid()));
+#endif
+    QCOMPARE(job->data().value(QLatin1String("callerUid")), job->data().value(QLatin1String("uid")));
+}
+
+void HelperTest::testSameActionInParallel()
+{
+    // Each job has to get its own reply, even though they all run the same action
+    QList<KAuth::ExecuteJob *> jobs;
+    for (int i = 0; i < 5; ++i) {
+        KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.echoaction"));
+        action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+        action.setArguments({{QLatin1String("job"), i}});
+
+        KAuth::ExecuteJob *job = action.execute();
+        job->setAutoDelete(false);
+        job->start();
+        jobs.append(job);
+    }
+
+    for (int i = 0; i < jobs.size(); ++i) {
+        QTRY_VERIFY_WITH_TIMEOUT(jobs.at(i)->isFinished(), 5000);
+        QVERIFY(!jobs.at(i)->error());
+        QCOMPARE(jobs.at(i)->data().value(QLatin1String("job")).toInt(), i);
+    }
+    qDeleteAll(jobs);
+}
+
 void HelperTest::testActionData()
 {
     KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.echoaction"));
@@ -227,6 +479,80 @@ void HelperTest::testActionData()
     QCOMPARE(job->data(), args);
 }
 
+void HelperTest::testActionDataTypes_data()
+{
+    QTest::addColumn<QVariantMap>("args");
+
+    QTest::newRow("plain") << QVariantMap{
+        {QStringLiteral("bool"), true},
+        {QStringLiteral("int"), -42},
+        {QStringLiteral("uint"), 42u},
+        {QStringLiteral("longlong"), Q_INT64_C(-5000000000)},
+        {QStringLiteral("ulonglong"), Q_UINT64_C(5000000000)},
+        {QStringLiteral("double"), 0.5},
+        {QStringLiteral("string"), QStringLiteral("kauth")},
+        {QStringLiteral("bytes"), QByteArray("\0\1\2", 3)},
+        {QStringLiteral("date"), QDateTime(QDate(2026, 1, 1), QTime(12, 0), QTimeZone::UTC)},
+        {QStringLiteral("strings"), QStringList{QStringLiteral("a"), QStringLiteral("b")}},
+    };
+    QTest::newRow("nested") << QVariantMap{
+        {QStringLiteral("ints"), QVariantList{1, 2, 3}},
+        {QStringLiteral("doubles"), QVariantList{1.5, 2.5}},
+        {QStringLiteral("mixed"), QVariantList{1, QStringLiteral("two"), 3.0}},
+        {QStringLiteral("map"), QVariantMap{{QStringLiteral("ints"), QVariantList{4, 5}}}},
+    };
+    // Not representable in CBOR, has to fall back to QDataStream
+    QTest::newRow("fallback") << QVariantMap{
+        {QStringLiteral("point"), QPoint(1, 2)},
+        {QStringLiteral("int"), 1},
+    };
+    // CBOR would turn it into UTC
+    QTest::newRow("local time") << QVariantMap{
+        {QStringLiteral("date"), QDateTime(QDate(2026, 1, 1), QTime(12, 0), QTimeZone::LocalTime)},
+    };
+}
+
+void HelperTest::testActionDataTypes()
+{
+    QFETCH(QVariantMap, args);
+
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.echoaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    action.setArguments(args);
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QVERIFY(job->exec());
+    QVERIFY(!job->error());
+    QCOMPARE(job->data(), args);
+}
+
+void HelperTest::testRejectedArguments_data()
+{
+    QTest::addColumn<QVariant>("value");
+
+    // Decoding images would run the image loaders in the helper
+    const QImage image(1, 1, QImage::Format_RGB32);
+    QTest::newRow("image") << QVariant(image);
+    // Containers don't hide them from the check
+    QTest::newRow("image in list") << QVariant(QVariantList{1, image});
+    QTest::newRow("image in map") << QVariant(QVariantMap{{QStringLiteral("a"), 1}, {QStringLiteral("b"), image}});
+}
+
+void HelperTest::testRejectedArguments()
+{
+    QFETCH(QVariant, value);
+
+    KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.echoaction"));
+    action.setHelperId(QLatin1String("org.kde.kf6auth.autotest"));
+    action.setArguments({{QStringLiteral("value"), value}});
+    QVERIFY(action.isValid());
+
+    KAuth::ExecuteJob *job = action.execute();
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), (int)KAuth::ActionReply::InvalidActionError);
+}
+
 void HelperTest::testHelperFailure()
 {
     KAuth::Action action(QLatin1String("org.kde.kf6auth.autotest.failingaction"));
@@ -5,6 +5,7 @@
 */
 
 #include "BackendsManager.h"
+#include <QFuture>
 #include <QTest>
 #include <kauth/actionreply.h>
 #include <kauth/executejob.h>
@@ -28,6 +29,7 @@ private Q_SLOTS:
     void testBasicActionProperties();
     void testUserAuthorization();
     void testAuthorizationFail();
+    void testQueryStatuses();
 
     void cleanup()
     {
@@ -124,5 +126,25 @@ void SetupActionTest::testAuthorizationFail()
     QVERIFY(job->data().isEmpty());
 }
 
+void SetupActionTest::testQueryStatuses()
+{
+    const KAuth::Action authorized(QLatin1String("always.authorized"));
+    const KAuth::Action doomed(QLatin1String("doomed.to.fail"));
+    const KAuth::Action requiresAuth(QLatin1String("requires.auth"));
+
+    auto future = KAuth::queryStatuses({authorized.name(), doomed.name(), requiresAuth.name(), QLatin1String("i.do.not.exist"), QString()});
+    future.waitForFinished();
+    QVERIFY(future.isValid());
+
+    const QHash<QString, KAuth::Action::AuthStatus> statuses = future.result();
+    QCOMPARE(statuses.size(), 5);
+    QCOMPARE(statuses.value(authorized.name()), authorized.status());
+    QCOMPARE(statuses.value(authorized.name()), KAuth::Action::AuthorizedStatus);
+    QCOMPARE(statuses.value(doomed.name()), KAuth::Action::DeniedStatus);
+    QCOMPARE(statuses.value(requiresAuth.name()), KAuth::Action::AuthRequiredStatus);
+    QCOMPARE(statuses.value(QLatin1String("i.do.not.exist")), KAuth::Action::InvalidStatus);
+    QCOMPARE(statuses.value(QString()), KAuth::Action::InvalidStatus);
+}
+
 QTEST_MAIN(SetupActionTest)
 #include "SetupActionTest.moc"
@@ -7,6 +7,10 @@
 #include "TestBackend.h"
 
 #include <QDebug>
+#include <QPromise>
+#include <QTimer>
+
+#include <memory>
 
 namespace KAuth
 {
@@ -63,14 +67,15 @@ bool TestBackend::isCallerAuthorized(const QString &action, const QByteArray &ca
 {
     Q_UNUSED(details);
 
+    // The helper shares this backend with the client in the tests. Its verdict is only announced,
+    // like a real backend would after authenticating, and must not change what the client's
+    // Action::status() reports for actions that are still alive.
     if (action == QLatin1String("doomed.to.fail")) {
         return false;
     } else if (action == QLatin1String("requires.auth")) {
-        m_actionStatuses.insert(action, Action::AuthorizedStatus);
         Q_EMIT actionStatusChanged(action, Action::AuthorizedStatus);
         return true;
     } else if (action == QLatin1String("generates.error")) {
-        m_actionStatuses.insert(action, Action::ErrorStatus);
         Q_EMIT actionStatusChanged(action, Action::ErrorStatus);
         return false;
     } else if (action == QLatin1String("always.authorized")) {
@@ -78,11 +83,9 @@ bool TestBackend::isCallerAuthorized(const QString &action, const QByteArray &ca
     } else if (action.startsWith(QLatin1String("org.kde.kf6auth.autotest"))) {
         qDebug() << "Caller ID:" << callerId << callerID();
         if (callerId == callerID()) {
-            m_actionStatuses.insert(action, Action::AuthorizedStatus);
             Q_EMIT actionStatusChanged(action, Action::AuthorizedStatus);
             return true;
         } else {
-            m_actionStatuses.insert(action, Action::DeniedStatus);
             Q_EMIT actionStatusChanged(action, Action::DeniedStatus);
         }
     }
@@ -90,6 +93,25 @@ bool TestBackend::isCallerAuthorized(const QString &action, const QByteArray &ca
     return false;
 }
 
+QFuture<bool> TestBackend::isCallerAuthorizedAsync(const QString &action,
+                                                   const QByteArray &callerID,
+                                                   const QVariantMap &details,
+                                                   const HelperSupport::CallerCredentials &credentials)
+{
+    if (action != QLatin1String("org.kde.kf6auth.autotest.longaction")) {
+        return AuthBackend::isCallerAuthorizedAsync(action, callerID, details, credentials);
+    }
+
+    // Pretend the user takes a while to authenticate, the helper has to keep serving other calls meanwhile
+    auto promise = std::make_shared<QPromise<bool>>();
+    promise->start();
+    QTimer::singleShot(250, this, [this, promise, action, callerID, details]() {
+        promise->addResult(isCallerAuthorized(action, callerID, details));
+        promise->finish();
+    });
+    return promise->future();
+}
+
 } // namespace Auth
 
 #include "moc_TestBackend.cpp"
@@ -26,6 +26,10 @@ public:
     Action::AuthStatus actionStatus(const QString &) override;
     QByteArray callerID() const override;
     bool isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details) override;
+    QFuture<bool> isCallerAuthorizedAsync(const QString &action,
+                                          const QByteArray &callerID,
+                                          const QVariantMap &details,
+                                          const HelperSupport::CallerCredentials &credentials) override;
 
 public Q_SLOTS:
     void setNewCapabilities(KAuth::AuthBackend::Capabilities capabilities);
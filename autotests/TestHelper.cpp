@@ -9,12 +9,20 @@
 #include <helpersupport.h>
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QEventLoop>
 #include <QFile>
+#include <QPromise>
 #include <QTextStream>
 #include <QThread>
+#include <QTimer>
+#include <QUrl>
 #include <qplatformdefs.h>
 
+#ifdef Q_OS_LINUX
+#include <poll.h>
+#endif
+
 ActionReply TestHelper::echoaction(QVariantMap args)
 {
     qDebug() << "Echo action running";
@@ -55,10 +63,133 @@ ActionReply TestHelper::longaction(QVariantMap args)
     return ActionReply::SuccessReply();
 }
 
+ActionReply TestHelper::dataaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+
+    QVariantMap plain;
+    plain.insert(QLatin1String("Answer"), 42);
+    HelperSupport::progressStep(plain);
+
+    // Not a D-Bus type, has to take the detour through a blob
+    QVariantMap url;
+    url.insert(QLatin1String("Where"), QUrl(QStringLiteral("https://kde.org")));
+    HelperSupport::progressStep(url);
+
+    return ActionReply::SuccessReply();
+}
+
 ActionReply TestHelper::failingaction(QVariantMap args)
 {
     Q_UNUSED(args)
     return ActionReply::HelperErrorReply();
 }
 
+ActionReply TestHelper::threadedaction(QVariantMap args)
+{
+    qDebug() << "Threaded action running";
+
+    for (int i = 1; i <= 10; i++) {
+        HelperSupport::progressStep(i);
+    }
+
+    args.insert(QLatin1String("mainThread"), QThread::currentThread() == thread());
+    ActionReply reply = ActionReply::SuccessReply();
+    reply.setData(args);
+
+    return reply;
+}
+
+ActionReply TestHelper::threadedlongaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+    qDebug() << "Threaded long action running, it takes 3 seconds to complete";
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!HelperSupport::isStopped() && !timer.hasExpired(3000)) {
+        QThread::msleep(10);
+    }
+
+    return ActionReply::SuccessReply();
+}
+
+QFuture<ActionReply> TestHelper::futureaction(QVariantMap args)
+{
+    qDebug() << "Future action running";
+
+    // Resolve from the event loop later on, like a helper waiting on another service would
+    auto promise = std::make_shared<QPromise<ActionReply>>();
+    promise->start();
+    QTimer::singleShot(100, this, [promise, args]() {
+        ActionReply reply = ActionReply::SuccessReply();
+        reply.setData(args);
+        promise->addResult(reply);
+        promise->finish();
+    });
+
+    return promise->future();
+}
+
+QFuture<ActionReply> TestHelper::emptyfutureaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+
+    // Finished right away, but without ever adding a result
+    QPromise<ActionReply> promise;
+    promise.start();
+    promise.finish();
+
+    return promise.future();
+}
+
+ActionReply TestHelper::stoppableaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+    qDebug() << "Stoppable action running, waiting to be stopped";
+
+#ifdef Q_OS_LINUX
+    // Blocks the helper's main thread, the stop request has to get through anyway
+    pollfd stopFd = {HelperSupport::stopFileDescriptor(), POLLIN, 0};
+    poll(&stopFd, 1, 10000);
+#endif
+
+    ActionReply reply = ActionReply::SuccessReply();
+    reply.addData(QLatin1String("stopped"), HelperSupport::isStopped());
+
+    return reply;
+}
+
+ActionReply TestHelper::pollingaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+    qDebug() << "Polling action running, waiting to be stopped";
+
+    // Blocks the helper's main thread, only looking for a stop now and then
+    QElapsedTimer timer;
+    timer.start();
+    while (!HelperSupport::isStopped() && !timer.hasExpired(10000)) {
+        QThread::msleep(10);
+    }
+
+    ActionReply reply = ActionReply::SuccessReply();
+    reply.addData(QLatin1String("stopped"), HelperSupport::isStopped());
+
+    return reply;
+}
+
+ActionReply TestHelper::credentialsaction(QVariantMap args)
+{
+    Q_UNUSED(args);
+
+    const HelperSupport::CallerCredentials credentials = HelperSupport::callerCredentials();
+
+    ActionReply reply = ActionReply::SuccessReply();
+    reply.addData(QLatin1String("uid"), credentials.uid());
+    reply.addData(QLatin1String("pid"), credentials.pid());
+    reply.addData(QLatin1String("callerUid"), HelperSupport::callerUid());
+
+    return reply;
+}
+
 #include "moc_TestHelper.cpp"
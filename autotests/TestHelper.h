@@ -7,9 +7,11 @@
 #ifndef TEST_HELPER_H
 #define TEST_HELPER_H
 
+#include <QFuture>
 #include <QObject>
 
 #include <actionreply.h>
+#include <helpersupport.h>
 
 using namespace KAuth;
 
@@ -21,7 +23,15 @@ public Q_SLOTS:
     ActionReply echoaction(QVariantMap args);
     ActionReply standardaction(QVariantMap args);
     ActionReply longaction(QVariantMap args);
+    ActionReply dataaction(QVariantMap args);
     ActionReply failingaction(QVariantMap args);
+    KAUTH_THREADED ActionReply threadedaction(QVariantMap args);
+    KAUTH_THREADED ActionReply threadedlongaction(QVariantMap args);
+    QFuture<ActionReply> futureaction(QVariantMap args);
+    QFuture<ActionReply> emptyfutureaction(QVariantMap args);
+    ActionReply stoppableaction(QVariantMap args);
+    ActionReply pollingaction(QVariantMap args);
+    KAUTH_THREADED ActionReply credentialsaction(QVariantMap args);
 };
 
 #endif
@@ -49,6 +49,43 @@ void AuthBackend::preAuthAction(const QString &action, QWindow *parent)
     Q_UNUSED(parent)
 }
 
+QFuture<QHash<QString, Action::AuthStatus>> AuthBackend::actionStatuses(const QStringList &actions)
+{
+    QHash<QString, Action::AuthStatus> statuses;
+    statuses.reserve(actions.size());
+    for (const QString &action : actions) {
+        statuses.insert(action, actionStatus(action));
+    }
+    return QtFuture::makeReadyValueFuture(statuses);
+}
+
+void AuthBackend::invalidateActionStatus(const QString &action)
+{
+    Q_UNUSED(action)
+}
+
+QFuture<bool> AuthBackend::isCallerAuthorizedAsync(const QString &action,
+                                                   const QByteArray &callerID,
+                                                   const QVariantMap &details,
+                                                   const HelperSupport::CallerCredentials &credentials)
+{
+    Q_UNUSED(credentials)
+    return QtFuture::makeReadyValueFuture(isCallerAuthorized(action, callerID, details));
+}
+
+bool AuthBackend::isCallerAuthorizationCached(const QString &action, const QByteArray &callerID, const QVariantMap &details)
+{
+    Q_UNUSED(action)
+    Q_UNUSED(callerID)
+    Q_UNUSED(details)
+    return false;
+}
+
+void AuthBackend::setAuthorizationCacheTimeout(int msec)
+{
+    Q_UNUSED(msec)
+}
+
 QVariantMap AuthBackend::backendDetails(const DetailsMap &details)
 {
     Q_UNUSED(details);
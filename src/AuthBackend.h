@@ -11,6 +11,7 @@
 #include <QObject>
 
 #include "action.h"
+#include "helpersupport.h"
 #include "kauthcore_export.h"
 
 namespace KAuth
@@ -37,8 +38,23 @@ public:
     virtual void preAuthAction(const QString &action, QWindow *parent);
     virtual Action::AuthStatus authorizeAction(const QString &action) = 0;
     virtual Action::AuthStatus actionStatus(const QString &action) = 0;
+    // Status of several actions at once, the default implementation calls actionStatus() for each of them
+    virtual QFuture<QHash<QString, Action::AuthStatus>> actionStatuses(const QStringList &actions);
+    // Drops what the backend remembers about the status of action, the next actionStatus() call asks again
+    virtual void invalidateActionStatus(const QString &action);
     virtual QByteArray callerID() const = 0;
     virtual bool isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details) = 0;
+    // Same as isCallerAuthorized() without waiting for the answer, the default implementation calls it.
+    // credentials are those the helper already resolved for the caller, backends can identify it by them
+    virtual QFuture<bool> isCallerAuthorizedAsync(const QString &action,
+                                                  const QByteArray &callerID,
+                                                  const QVariantMap &details,
+                                                  const HelperSupport::CallerCredentials &credentials);
+    // Whether a positive answer for the caller is still remembered, so isCallerAuthorizedAsync() needs no credentials.
+    // The default implementation remembers nothing
+    virtual bool isCallerAuthorizationCached(const QString &action, const QByteArray &callerID, const QVariantMap &details);
+    // How long isCallerAuthorized() may remember a positive answer, 0 disables remembering. Backends may ignore it
+    virtual void setAuthorizationCacheTimeout(int msec);
     virtual QVariantMap backendDetails(const DetailsMap &details);
 
     Capabilities capabilities() const;
@@ -58,6 +74,6 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(AuthBackend::Capabilities)
 
 } // namespace Auth
 
-Q_DECLARE_INTERFACE(KAuth::AuthBackend, "org.kde.kf6auth.AuthBackend/0.1")
+Q_DECLARE_INTERFACE(KAuth::AuthBackend, "org.kde.kf6auth.AuthBackend/0.2")
 
 #endif
@@ -95,6 +95,7 @@ elseif(KAUTH_BACKEND_NAME STREQUAL "POLKITQT6-1")
 
     set(KAUTH_BACKEND_SRCS
         backends/polkit-1/Polkit1Backend.cpp
+        backends/polkit-1/Polkit1AuthorityClient.cpp
     )
 
     set(KAUTH_BACKEND_LIBS ${POLKITQT-1_CORE_LIBRARY} Qt6::DBus Qt6::Gui KF6::AuthCore KF6::WindowSystem)
@@ -163,6 +164,8 @@ if(KAUTH_HELPER_BACKEND_NAME STREQUAL "DBUS")
                         KAuth::DBusHelperProxy)
 
     set(KAUTH_HELPER_BACKEND_SRCS
+        backends/dbus/ArgumentDecoder.cpp
+        backends/dbus/CborCodec.cpp
         backends/dbus/DBusHelperProxy.cpp
         ${kauth_dbus_adaptor_SRCS}
     )
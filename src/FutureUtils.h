@@ -0,0 +1,38 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#ifndef KAUTH_FUTURE_UTILS_H
+#define KAUTH_FUTURE_UTILS_H
+
+#include <QFuture>
+#include <QFutureWatcher>
+
+#include <utility>
+
+namespace KAuth
+{
+// Calls onCanceled in context's thread once future is canceled. The watcher goes away once future is finished.
+template<typename T, typename Function>
+void onFutureCanceled(const QFuture<T> &future, QObject *context, Function &&onCanceled)
+{
+    auto *watcher = new QFutureWatcher<T>(context);
+    QObject::connect(watcher, &QFutureWatcherBase::canceled, context, std::forward<Function>(onCanceled));
+    QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+    watcher->setFuture(future);
+}
+
+// Cancels inner along with outer, e.g. to withdraw the work a promise is waiting for
+template<typename T, typename U>
+void forwardCancellation(const QFuture<T> &outer, QObject *context, QFuture<U> inner)
+{
+    onFutureCanceled(outer, context, [inner]() mutable {
+        inner.cancel();
+    });
+}
+
+} // namespace KAuth
+
+#endif
@@ -13,6 +13,18 @@ HelperProxy::~HelperProxy()
 {
 }
 
+int HelperProxy::stopFileDescriptor()
+{
+    return -1;
+}
+
+HelperSupport::CallerCredentials HelperProxy::callerCredentials() const
+{
+    HelperSupport::CallerCredentials credentials;
+    credentials.setUid(callerUid());
+    return credentials;
+}
+
 } // namespace KAuth
 
 #include "moc_HelperProxy.cpp"
@@ -15,6 +15,7 @@
 
 #include "action.h"
 #include "actionreply.h"
+#include "helpersupport.h"
 
 namespace KAuth
 {
@@ -27,9 +28,11 @@ class HelperProxy : public QObject
 public:
     ~HelperProxy() override;
 
-    // Application-side methods
-    virtual void executeAction(const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout) = 0;
-    virtual void stopAction(const QString &action, const QString &helperID) = 0;
+    // Application-side methods. The request id is chosen by the caller, unique among its requests, and
+    // passed back by the signals below, so that several requests for the same action can run at once.
+    virtual void
+    executeAction(uint requestId, const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout) = 0;
+    virtual void stopAction(uint requestId, const QString &action, const QString &helperID) = 0;
 
     // Helper-side methods
     virtual bool initHelper(const QString &name) = 0;
@@ -38,18 +41,22 @@ public:
     virtual void sendDebugMessage(int level, const char *msg) = 0;
     virtual void sendProgressStep(int step) = 0;
     virtual void sendProgressStepData(const QVariantMap &step) = 0;
+    // File descriptor that becomes readable once the current action is asked to stop, or -1.
+    virtual int stopFileDescriptor();
     // Attempts to resolve the UID of the unprivileged remote process.
     virtual int callerUid() const = 0;
+    // Credentials of the remote process, by default only its UID.
+    virtual HelperSupport::CallerCredentials callerCredentials() const;
 
 Q_SIGNALS:
-    void actionStarted(const QString &action);
-    void actionPerformed(const QString &action, const KAuth::ActionReply &reply);
-    void progressStep(const QString &action, int progress);
-    void progressStepData(const QString &action, const QVariantMap &data);
+    void actionStarted(uint requestId, const QString &action);
+    void actionPerformed(uint requestId, const QString &action, const KAuth::ActionReply &reply);
+    void progressStep(uint requestId, const QString &action, int progress);
+    void progressStepData(uint requestId, const QString &action, const QVariantMap &data);
 };
 
 } // namespace KAuth
 
-Q_DECLARE_INTERFACE(KAuth::HelperProxy, "org.kde.kf6auth.HelperProxy/0.1")
+Q_DECLARE_INTERFACE(KAuth::HelperProxy, "org.kde.kf6auth.HelperProxy/0.2")
 
 #endif
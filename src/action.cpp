@@ -6,6 +6,8 @@
 
 #include "action.h"
 
+#include <QHash>
+#include <QMutex>
 #include <QPointer>
 #include <QRegularExpression>
 #include <QWindow>
@@ -15,8 +17,69 @@
 
 #include "BackendsManager.h"
 
+#include <memory>
+#include <mutex>
+
 namespace KAuth
 {
+namespace
+{
+// Shared by all Action objects with the same name, lives as long as any of them does
+struct ActionRecord {
+    explicit ActionRecord(const QString &name)
+        : name(name)
+    {
+    }
+
+    const QString name;
+    std::once_flag setupFlag;
+};
+
+class ActionRegistry
+{
+public:
+    std::shared_ptr<ActionRecord> intern(const QString &name);
+
+private:
+    QMutex m_mutex;
+    QHash<QString, std::weak_ptr<ActionRecord>> m_records;
+};
+
+Q_GLOBAL_STATIC(ActionRegistry, s_actionRegistry)
+
+std::shared_ptr<ActionRecord> ActionRegistry::intern(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (auto record = m_records.value(name).lock()) {
+        return record;
+    }
+
+    std::shared_ptr<ActionRecord> record(new ActionRecord(name), [](ActionRecord *record) {
+        if (!s_actionRegistry.isDestroyed()) {
+            ActionRegistry *registry = s_actionRegistry();
+            QMutexLocker locker(&registry->m_mutex);
+            // The name may have been interned again in the meantime
+            const auto it = registry->m_records.constFind(record->name);
+            if (it != registry->m_records.cend() && it->expired()) {
+                registry->m_records.erase(it);
+            }
+        }
+        delete record;
+    });
+    m_records.insert(name, record);
+    return record;
+}
+
+// Lets the backend prepare for the action, once for all Action objects sharing the record
+void setupRecord(ActionRecord &record)
+{
+    std::call_once(record.setupFlag, [&record] {
+        BackendsManager::self().authBackend()->setupAction(record.name);
+    });
+}
+} // namespace
+
 class ActionData : public QSharedData
 {
 public:
@@ -28,6 +91,7 @@ public:
     ActionData(const ActionData &other)
         : QSharedData(other)
         , name(other.name)
+        , record(other.record)
         , helperId(other.helperId)
         , details(other.details)
         , args(other.args)
@@ -40,6 +104,7 @@ public:
     }
 
     QString name;
+    std::shared_ptr<ActionRecord> record;
     QString helperId;
     Action::DetailsMap details;
     QVariantMap args;
@@ -62,7 +127,6 @@ Action::Action(const QString &name)
     : d(new ActionData())
 {
     setName(name);
-    BackendsManager::self().authBackend()->setupAction(d->name);
 }
 
 Action::Action(const QString &name, const DetailsMap &details)
@@ -70,7 +134,6 @@ Action::Action(const QString &name, const DetailsMap &details)
 {
     setName(name);
     setDetailsV2(details);
-    BackendsManager::self().authBackend()->setupAction(d->name);
 }
 
 Action::~Action()
@@ -107,7 +170,14 @@ QString Action::name() const
 
 void Action::setName(const QString &name)
 {
-    d->name = name;
+    if (name.isEmpty()) {
+        d->record.reset();
+        d->name = name;
+        return;
+    }
+
+    d->record = s_actionRegistry()->intern(name);
+    d->name = d->record->name;
 }
 
 // Accessors
@@ -173,16 +243,51 @@ QWindow *Action::parentWindow() const
 }
 
 Action::AuthStatus Action::status() const
+{
+    return status(CachedStatusMode);
+}
+
+Action::AuthStatus Action::status(StatusQueryMode mode) const
 {
     if (!isValid()) {
         return Action::InvalidStatus;
     }
 
+    setupRecord(*d->record);
+
+    if (mode == RefreshStatusMode) {
+        BackendsManager::self().authBackend()->invalidateActionStatus(d->name);
+    }
+
     return BackendsManager::self().authBackend()->actionStatus(d->name);
 }
 
+QFuture<QHash<QString, Action::AuthStatus>> queryStatuses(const QStringList &actions)
+{
+    QStringList validActions = actions;
+    validActions.removeDuplicates();
+    const bool hasInvalid = validActions.removeAll(QString()) > 0;
+
+    for (const QString &action : std::as_const(validActions)) {
+        setupRecord(*s_actionRegistry()->intern(action));
+    }
+
+    auto future = BackendsManager::self().authBackend()->actionStatuses(validActions);
+    if (!hasInvalid) {
+        return future;
+    }
+
+    return future.then([](QHash<QString, Action::AuthStatus> statuses) {
+        statuses.insert(QString(), Action::InvalidStatus);
+        return statuses;
+    });
+}
+
 ExecuteJob *Action::execute(ExecutionMode mode)
 {
+    if (d->record) {
+        setupRecord(*d->record);
+    }
     return new ExecuteJob(*this, mode, nullptr);
 }
 
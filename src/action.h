@@ -11,9 +11,11 @@
 
 #include "kauthcore_export.h"
 
+#include <QFuture>
 #include <QHash>
 #include <QSharedDataPointer>
 #include <QString>
+#include <QStringList>
 #include <QVariant>
 
 #if __has_include(<chrono>)
@@ -115,6 +117,22 @@ public:
     };
     Q_ENUM(ExecutionMode)
 
+    /*!
+     * How status() obtains the authorization status
+     *
+     * \value CachedStatusMode Use the status the backend already knows about, if any. Backends keep it
+     *        up to date when the authorization policy changes
+     * \value RefreshStatusMode Ask the authorization system again, e.g. after changing the policy
+     *        in a way the backend is not notified about
+     *
+     * \since 6.29
+     */
+    enum StatusQueryMode {
+        CachedStatusMode,
+        RefreshStatusMode,
+    };
+    Q_ENUM(StatusQueryMode)
+
     /*!
      * The backend specific details.
      *
@@ -147,6 +165,9 @@ public:
     /*!
      * This creates a new action object with this name
      * \a name The name of the new action
+     *
+     * Constructing an action is cheap, the authorization backend is only
+     * consulted once the status is needed or the action is executed.
      */
     Action(const QString &name);
 
@@ -395,9 +416,21 @@ public:
      * \li Action::AuthRequired if the user could acquire the authorization after authentication,
      * \li Action::UserCancelled if the user cancels the authentication dialog. Not currently supported by the Polkit backend
      * \endlist
+     *
+     * The status may come from the backend's cache, same as status(CachedStatusMode).
      */
     AuthStatus status() const;
 
+    /*!
+     * \brief Gets information about the authorization status of an action
+     *
+     * Same as status(), \a mode tells whether a cached status may be returned
+     * or the authorization system has to be asked again.
+     *
+     * \since 6.29
+     */
+    AuthStatus status(StatusQueryMode mode) const;
+
     /*!
      * \brief Get the job object used to execute the action
      *
@@ -434,6 +467,22 @@ private:
     QSharedDataPointer<ActionData> d;
 };
 
+/*!
+ * \relates KAuth::Action
+ *
+ * \brief Gets the authorization status of several actions at once
+ *
+ * Asks the authorization backend about all of \a actions without blocking,
+ * which is considerably faster than calling Action::status() on each of them
+ * when the backend has to ask a remote authorization system.
+ *
+ * The returned future resolves to a hash mapping each of \a actions to its status,
+ * as Action::status() would have returned it. Empty action names map to Action::InvalidStatus.
+ *
+ * \since 6.29
+ */
+KAUTHCORE_EXPORT QFuture<QHash<QString, Action::AuthStatus>> queryStatuses(const QStringList &actions);
+
 } // namespace Auth
 
 Q_DECLARE_TYPEINFO(KAuth::Action, Q_RELOCATABLE_TYPE);
@@ -0,0 +1,205 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "ArgumentDecoder.h"
+
+#include <QDataStream>
+#include <QVariantHash>
+#include <QVariantList>
+
+namespace KAuth
+{
+namespace ArgumentDecoder
+{
+namespace
+{
+// Deeper nesting than any real action uses, keeps a crafted blob from exhausting the stack
+constexpr int c_maxDepth = 32;
+
+std::optional<QVariant> readVariant(QDataStream &stream, int depth);
+
+// Container size, see QDataStream::readQSizeType()
+std::optional<qint64> readSize(QDataStream &stream)
+{
+    quint32 size;
+    stream >> size;
+    if (stream.status() != QDataStream::Ok || size == quint32(QDataStream::NullCode)) {
+        return std::nullopt;
+    }
+    if (size < quint32(QDataStream::ExtendedSize) || stream.version() < QDataStream::Qt_6_7) {
+        return size;
+    }
+
+    qint64 extendedSize;
+    stream >> extendedSize;
+    if (extendedSize < 0) {
+        return std::nullopt;
+    }
+    return extendedSize;
+}
+
+template<typename Map>
+std::optional<Map> readMap(QDataStream &stream, int depth)
+{
+    const std::optional<qint64> size = readSize(stream);
+    if (!size) {
+        return std::nullopt;
+    }
+
+    // Not reserving anything, a bogus size runs out of data long before it runs out of memory
+    Map map;
+    for (qint64 i = 0; i < *size && stream.status() == QDataStream::Ok; ++i) {
+        QString key;
+        stream >> key;
+        const std::optional<QVariant> value = readVariant(stream, depth + 1);
+        if (!value) {
+            return std::nullopt;
+        }
+        map.insert(key, *value);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        return std::nullopt;
+    }
+    return map;
+}
+
+std::optional<QVariantList> readList(QDataStream &stream, int depth)
+{
+    const std::optional<qint64> size = readSize(stream);
+    if (!size) {
+        return std::nullopt;
+    }
+
+    QVariantList list;
+    for (qint64 i = 0; i < *size && stream.status() == QDataStream::Ok; ++i) {
+        const std::optional<QVariant> value = readVariant(stream, depth + 1);
+        if (!value) {
+            return std::nullopt;
+        }
+        list.append(*value);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        return std::nullopt;
+    }
+    return list;
+}
+
+// Mirrors QVariant::load(), minus the lookup of arbitrary types
+std::optional<QVariant> readVariant(QDataStream &stream, int depth)
+{
+    if (depth > c_maxDepth) {
+        return std::nullopt;
+    }
+
+    quint32 typeId;
+    qint8 isNull;
+    stream >> typeId >> isNull;
+    if (stream.status() != QDataStream::Ok) {
+        return std::nullopt;
+    }
+
+    // Custom types are sent by name, none of them is accepted
+    const QMetaType type(typeId);
+    if (typeId >= QMetaType::User || !isAllowedType(type)) {
+        return std::nullopt;
+    }
+
+    QVariant value;
+    switch (typeId) {
+    case QMetaType::UnknownType:
+        return QVariant();
+    case QMetaType::QVariantMap:
+        if (auto map = readMap<QVariantMap>(stream, depth)) {
+            value = *map;
+        }
+        break;
+    case QMetaType::QVariantHash:
+        if (auto hash = readMap<QVariantHash>(stream, depth)) {
+            value = *hash;
+        }
+        break;
+    case QMetaType::QVariantList:
+        if (auto list = readList(stream, depth)) {
+            value = *list;
+        }
+        break;
+    default:
+        value = QVariant(type);
+        if (!type.load(stream, value.data())) {
+            return std::nullopt;
+        }
+        break;
+    }
+
+    if (!value.isValid() || stream.status() != QDataStream::Ok) {
+        return std::nullopt;
+    }
+    // Null variants of a type still carry a default constructed value in the stream
+    return isNull ? QVariant(type) : value;
+}
+} // namespace
+
+bool isAllowedType(QMetaType type)
+{
+    switch (type.id()) {
+    case QMetaType::UnknownType:
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+    case QMetaType::Float:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+    case QMetaType::QChar:
+    case QMetaType::QString:
+    case QMetaType::QStringList:
+    case QMetaType::QByteArray:
+    case QMetaType::QByteArrayList:
+    case QMetaType::QDate:
+    case QMetaType::QTime:
+    case QMetaType::QDateTime:
+    case QMetaType::QUrl:
+    case QMetaType::QUuid:
+    case QMetaType::QPoint:
+    case QMetaType::QPointF:
+    case QMetaType::QSize:
+    case QMetaType::QSizeF:
+    case QMetaType::QRect:
+    case QMetaType::QRectF:
+    case QMetaType::QLine:
+    case QMetaType::QLineF:
+    case QMetaType::QVariantMap:
+    case QMetaType::QVariantHash:
+    case QMetaType::QVariantList:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<QVariantMap> decode(const QByteArray &blob)
+{
+    if (blob.isEmpty()) {
+        return QVariantMap();
+    }
+
+    QDataStream stream(blob);
+    std::optional<QVariantMap> arguments = readMap<QVariantMap>(stream, 0);
+    if (!arguments || !stream.atEnd()) {
+        return std::nullopt;
+    }
+    return arguments;
+}
+
+} // namespace ArgumentDecoder
+} // namespace KAuth
@@ -0,0 +1,38 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#ifndef KAUTH_ARGUMENTDECODER_H
+#define KAUTH_ARGUMENTDECODER_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QVariantMap>
+
+#include <optional>
+
+namespace KAuth
+{
+/*
+ * Reads the QDataStream encoded arguments of a request, as written by QDataStream << QVariantMap.
+ *
+ * Only plain value types are accepted. A value of any other type rejects the whole blob as soon as
+ * its type id is read, before that value is constructed; whatever was decoded before it is thrown
+ * away. In particular the gui types (QImage, QPixmap, QIcon...) can't reach their image loaders
+ * this way. Nested variant lists and maps are walked by the decoder itself, so the
+ * allowlist applies to their items as well. No global state is involved, blobs can be decoded on
+ * any thread, concurrently.
+ */
+namespace ArgumentDecoder
+{
+bool isAllowedType(QMetaType type);
+
+// Fails on unsupported types, malformed data and trailing garbage
+std::optional<QVariantMap> decode(const QByteArray &blob);
+} // namespace ArgumentDecoder
+
+} // namespace KAuth
+
+#endif
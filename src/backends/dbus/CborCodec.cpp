@@ -0,0 +1,381 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "CborCodec.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborStreamReader>
+#include <QCborValue>
+#include <QDateTime>
+#include <QHash>
+#include <QUrl>
+#include <QUuid>
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+
+namespace KAuth
+{
+namespace CborCodec
+{
+namespace
+{
+constexpr qint64 c_version = 1;
+
+// RFC 8746 typed arrays
+constexpr QCborTag c_int32ArrayTag{78}; // sint32, little endian
+constexpr QCborTag c_float64ArrayTag{86}; // float64, little endian
+// [type name, value] for types without a CBOR counterpart of their own
+constexpr QCborTag c_typedValueTag{27};
+
+constexpr char c_signature[] = "\xd9\xd9\xf7";
+
+class Encoder
+{
+public:
+    std::optional<QCborValue> encode(const QVariant &value);
+    std::optional<QCborValue> encodeMap(const QVariantMap &map);
+    QByteArray finish(const QCborValue &payload) const;
+
+private:
+    std::optional<QCborValue> encodeList(const QVariantList &list);
+    static QCborValue typedValue(const char *typeName, const QCborValue &value);
+
+    QHash<QString, qint64> m_keyIndexes;
+    QCborArray m_keys;
+};
+
+class Decoder
+{
+public:
+    // Returns the payload, or an invalid value if blob isn't one of ours
+    QCborValue start(const QByteArray &blob);
+    std::optional<QVariant> decode(const QCborValue &value) const;
+    std::optional<QVariantMap> decodeMap(const QCborValue &value) const;
+
+private:
+    std::optional<QVariant> decodeTagged(const QCborValue &value) const;
+
+    QCborArray m_keys;
+};
+
+QCborValue Encoder::typedValue(const char *typeName, const QCborValue &value)
+{
+    return QCborValue(c_typedValueTag, QCborArray{QString::fromLatin1(typeName), value});
+}
+
+std::optional<QCborValue> Encoder::encode(const QVariant &value)
+{
+    switch (value.typeId()) {
+    case QMetaType::UnknownType:
+        return QCborValue(QCborValue::Undefined);
+    case QMetaType::Bool:
+        return QCborValue(value.toBool());
+    case QMetaType::Int:
+        return QCborValue(qint64(value.toInt()));
+    case QMetaType::Double:
+        return QCborValue(value.toDouble());
+    case QMetaType::QString:
+        return QCborValue(value.toString());
+    case QMetaType::QByteArray:
+        return QCborValue(value.toByteArray());
+    case QMetaType::QVariantMap:
+        return encodeMap(value.toMap());
+    case QMetaType::QVariantList:
+        return encodeList(value.toList());
+    case QMetaType::QDateTime: {
+        // CBOR keeps the instant but not the time spec, it would come back as UTC
+        const QDateTime dateTime = value.toDateTime();
+        if (dateTime.timeSpec() != Qt::UTC) {
+            return std::nullopt;
+        }
+        return QCborValue(dateTime);
+    }
+    case QMetaType::QUrl:
+        return QCborValue(value.toUrl());
+    case QMetaType::QUuid:
+        return QCborValue(value.toUuid());
+    case QMetaType::UInt:
+        return typedValue("uint", QCborValue(qint64(value.toUInt())));
+    case QMetaType::LongLong:
+        return typedValue("qlonglong", QCborValue(value.toLongLong()));
+    case QMetaType::ULongLong:
+        if (value.toULongLong() > quint64(std::numeric_limits<qint64>::max())) {
+            return std::nullopt;
+        }
+        return typedValue("qulonglong", QCborValue(qint64(value.toULongLong())));
+    case QMetaType::QStringList:
+        return typedValue("QStringList", QCborArray::fromStringList(value.toStringList()));
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<QCborValue> Encoder::encodeMap(const QVariantMap &map)
+{
+    QCborMap result;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        auto index = m_keyIndexes.constFind(it.key());
+        if (index == m_keyIndexes.cend()) {
+            index = m_keyIndexes.insert(it.key(), m_keys.size());
+            m_keys.append(it.key());
+        }
+
+        const std::optional<QCborValue> value = encode(it.value());
+        if (!value) {
+            return std::nullopt;
+        }
+        result.insert(*index, *value);
+    }
+    return QCborValue(result);
+}
+
+std::optional<QCborValue> Encoder::encodeList(const QVariantList &list)
+{
+    const auto allOfType = [&list](QMetaType::Type type) {
+        return list.size() > 1 && std::all_of(list.cbegin(), list.cend(), [type](const QVariant &value) {
+                   return value.typeId() == type;
+               });
+    };
+
+    if (allOfType(QMetaType::Int)) {
+        QByteArray packed(list.size() * sizeof(qint32), Qt::Uninitialized);
+        for (qsizetype i = 0; i < list.size(); ++i) {
+            qToLittleEndian<qint32>(list.at(i).toInt(), packed.data() + i * sizeof(qint32));
+        }
+        return QCborValue(c_int32ArrayTag, packed);
+    }
+
+    if (allOfType(QMetaType::Double)) {
+        QByteArray packed(list.size() * sizeof(double), Qt::Uninitialized);
+        for (qsizetype i = 0; i < list.size(); ++i) {
+            qToLittleEndian<double>(list.at(i).toDouble(), packed.data() + i * sizeof(double));
+        }
+        return QCborValue(c_float64ArrayTag, packed);
+    }
+
+    QCborArray result;
+    for (const QVariant &item : list) {
+        const std::optional<QCborValue> value = encode(item);
+        if (!value) {
+            return std::nullopt;
+        }
+        result.append(*value);
+    }
+    return QCborValue(result);
+}
+
+QByteArray Encoder::finish(const QCborValue &payload) const
+{
+    return QCborValue(QCborKnownTags::Signature, QCborArray{c_version, m_keys, payload}).toCbor();
+}
+
+QCborValue Decoder::start(const QByteArray &blob)
+{
+    if (!isEncoded(blob)) {
+        return QCborValue(QCborValue::Invalid);
+    }
+
+    // A blob is a single item, anything after it means it's not what the sender meant to send
+    QCborStreamReader reader(blob);
+    const QCborValue value = QCborValue::fromCbor(reader);
+    if (reader.lastError() != QCborError::NoError || reader.currentOffset() != blob.size() || value.tag() != QCborKnownTags::Signature) {
+        return QCborValue(QCborValue::Invalid);
+    }
+
+    // Newer versions may store things differently, they are only sent to helpers announcing them
+    const QCborArray array = value.taggedValue().toArray();
+    if (array.size() != 3 || array.at(0).toInteger() != c_version || !array.at(1).isArray()) {
+        return QCborValue(QCborValue::Invalid);
+    }
+
+    m_keys = array.at(1).toArray();
+    return array.at(2);
+}
+
+std::optional<QVariant> Decoder::decode(const QCborValue &value) const
+{
+    switch (value.type()) {
+    case QCborValue::Undefined:
+        return QVariant();
+    case QCborValue::False:
+    case QCborValue::True:
+        return QVariant(value.toBool());
+    case QCborValue::Integer:
+        if (value.toInteger() < std::numeric_limits<int>::min() || value.toInteger() > std::numeric_limits<int>::max()) {
+            return std::nullopt;
+        }
+        return QVariant(int(value.toInteger()));
+    case QCborValue::Double:
+        return QVariant(value.toDouble());
+    case QCborValue::String:
+        return QVariant(value.toString());
+    case QCborValue::ByteArray:
+        return QVariant(value.toByteArray());
+    case QCborValue::Map:
+        return decodeMap(value);
+    case QCborValue::Array: {
+        QVariantList list;
+        const QCborArray array = value.toArray();
+        list.reserve(array.size());
+        for (const QCborValue &item : array) {
+            const std::optional<QVariant> decoded = decode(item);
+            if (!decoded) {
+                return std::nullopt;
+            }
+            list.append(*decoded);
+        }
+        return QVariant(list);
+    }
+    case QCborValue::DateTime:
+        return QVariant(value.toDateTime());
+    case QCborValue::Url:
+        return QVariant(value.toUrl());
+    case QCborValue::Uuid:
+        return QVariant(value.toUuid());
+    case QCborValue::Tag:
+        return decodeTagged(value);
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<QVariant> Decoder::decodeTagged(const QCborValue &value) const
+{
+    const QCborValue tagged = value.taggedValue();
+
+    if (value.tag() == c_int32ArrayTag || value.tag() == c_float64ArrayTag) {
+        const bool isInt = value.tag() == c_int32ArrayTag;
+        const qsizetype itemSize = isInt ? sizeof(qint32) : sizeof(double);
+        const QByteArray packed = tagged.toByteArray();
+        if (!tagged.isByteArray() || packed.size() % itemSize != 0) {
+            return std::nullopt;
+        }
+
+        QVariantList list;
+        list.reserve(packed.size() / itemSize);
+        for (qsizetype offset = 0; offset < packed.size(); offset += itemSize) {
+            if (isInt) {
+                list.append(qFromLittleEndian<qint32>(packed.constData() + offset));
+            } else {
+                list.append(qFromLittleEndian<double>(packed.constData() + offset));
+            }
+        }
+        return QVariant(list);
+    }
+
+    if (value.tag() == c_typedValueTag) {
+        const QCborArray array = tagged.toArray();
+        if (array.size() != 2) {
+            return std::nullopt;
+        }
+        const QString typeName = array.at(0).toString();
+        const QCborValue item = array.at(1);
+
+        if (typeName == QLatin1String("uint") && item.isInteger() && item.toInteger() >= 0
+            && item.toInteger() <= std::numeric_limits<uint>::max()) {
+            return QVariant(uint(item.toInteger()));
+        } else if (typeName == QLatin1String("qlonglong") && item.isInteger()) {
+            return QVariant(qlonglong(item.toInteger()));
+        } else if (typeName == QLatin1String("qulonglong") && item.isInteger() && item.toInteger() >= 0) {
+            return QVariant(qulonglong(item.toInteger()));
+        } else if (typeName == QLatin1String("QStringList") && item.isArray()) {
+            QStringList list;
+            for (const QCborValue &string : item.toArray()) {
+                if (!string.isString()) {
+                    return std::nullopt;
+                }
+                list.append(string.toString());
+            }
+            return QVariant(list);
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<QVariantMap> Decoder::decodeMap(const QCborValue &value) const
+{
+    if (!value.isMap()) {
+        return std::nullopt;
+    }
+
+    QVariantMap map;
+    const QCborMap cborMap = value.toMap();
+    for (auto it = cborMap.cbegin(); it != cborMap.cend(); ++it) {
+        // Out of range indexes yield an undefined key
+        const QCborValue key = m_keys.at(it.key().toInteger(-1));
+        if (!key.isString()) {
+            return std::nullopt;
+        }
+
+        const std::optional<QVariant> item = decode(it.value());
+        if (!item) {
+            return std::nullopt;
+        }
+        map.insert(key.toString(), *item);
+    }
+    return map;
+}
+} // namespace
+
+bool isEncoded(const QByteArray &blob)
+{
+    // A QDataStream blob starts with the size of the map, which can't be anywhere near this
+    return blob.startsWith(QByteArrayView(c_signature, sizeof(c_signature) - 1));
+}
+
+std::optional<QByteArray> encodeArguments(const QVariantMap &arguments)
+{
+    Encoder encoder;
+    const std::optional<QCborValue> payload = encoder.encodeMap(arguments);
+    if (!payload) {
+        return std::nullopt;
+    }
+    return encoder.finish(*payload);
+}
+
+std::optional<QVariantMap> decodeArguments(const QByteArray &blob)
+{
+    Decoder decoder;
+    return decoder.decodeMap(decoder.start(blob));
+}
+
+std::optional<QByteArray> encodeReply(const ActionReply &reply)
+{
+    Encoder encoder;
+    const std::optional<QCborValue> data = encoder.encodeMap(reply.data());
+    if (!data) {
+        return std::nullopt;
+    }
+    return encoder.finish(QCborArray{*data, reply.error(), static_cast<qint64>(reply.type()), reply.errorDescription()});
+}
+
+std::optional<ActionReply> decodeReply(const QByteArray &blob)
+{
+    Decoder decoder;
+    const QCborArray payload = decoder.start(blob).toArray();
+    if (payload.size() != 4 || !payload.at(1).isInteger() || !payload.at(2).isInteger()) {
+        return std::nullopt;
+    }
+
+    const std::optional<QVariantMap> data = decoder.decodeMap(payload.at(0));
+    if (!data) {
+        return std::nullopt;
+    }
+
+    ActionReply reply;
+    reply.setData(*data);
+    reply.setError(int(payload.at(1).toInteger()));
+    reply.setType(static_cast<ActionReply::Type>(payload.at(2).toInteger()));
+    reply.setErrorDescription(payload.at(3).toString());
+    return reply;
+}
+
+} // namespace CborCodec
+} // namespace KAuth
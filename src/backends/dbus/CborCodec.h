@@ -0,0 +1,42 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#ifndef KAUTH_CBORCODEC_H
+#define KAUTH_CBORCODEC_H
+
+#include "actionreply.h"
+
+#include <QByteArray>
+#include <QVariantMap>
+
+#include <optional>
+
+namespace KAuth
+{
+/*
+ * Compact encoding of the arguments and replies exchanged with the helper, used instead of
+ * QDataStream when both sides support it.
+ *
+ * A blob is a self-described CBOR array [version, keys, payload]. Map keys are stored once in
+ * keys and referred to by their index. Lists of ints or doubles are packed into typed arrays
+ * (RFC 8746). Values whose type can't be represented make encoding fail, the caller then sends
+ * a QDataStream blob instead, which the receiving side recognizes with isEncoded().
+ */
+namespace CborCodec
+{
+// Whether blob was produced by this codec rather than by QDataStream
+bool isEncoded(const QByteArray &blob);
+
+std::optional<QByteArray> encodeArguments(const QVariantMap &arguments);
+std::optional<QVariantMap> decodeArguments(const QByteArray &blob);
+
+std::optional<QByteArray> encodeReply(const ActionReply &reply);
+std::optional<ActionReply> decodeReply(const QByteArray &blob);
+} // namespace CborCodec
+
+} // namespace KAuth
+
+#endif
@@ -7,29 +7,163 @@
 */
 
 #include "DBusHelperProxy.h"
+#include "ArgumentDecoder.h"
 #include "BackendsManager.h"
+#include "CborCodec.h"
+#include "FutureUtils.h"
 #include "kauthdebug.h"
 #include "kf6authadaptor.h"
 
-#include <QDBusConnectionInterface>
+#include <QCoreApplication>
 #include <QDBusMessage>
 #include <QDBusMetaType>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 #include <QDBusUnixFileDescriptor>
+#include <QFutureWatcher>
 #include <QMap>
 #include <QMetaMethod>
 #include <QObject>
+#include <QPromise>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <qplugin.h>
 
-extern Q_CORE_EXPORT const QtPrivate::QMetaTypeInterface *qMetaTypeGuiHelper;
+#include <algorithm>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 namespace KAuth
 {
 static void debugMessageReceived(int t, const QString &message);
 
+// For legacy reasons we could be dealing with ActionReply types (i.e.
+// `using namespace KAuth`), so the return type may be spelled with or without namespace.
+static bool isActionReplyType(QMetaType type, QByteArrayView name)
+{
+    return type == QMetaType::fromType<ActionReply>() || name == "ActionReply" || name == "KAuth::ActionReply";
+}
+
+static bool isFutureReplyType(QMetaType type, QByteArrayView name)
+{
+    return type == QMetaType::fromType<QFuture<ActionReply>>() || name == "QFuture<ActionReply>" || name == "QFuture<KAuth::ActionReply>";
+}
+
+static std::optional<QVariantMap> decodeArguments(const QByteArray &arguments, const QMap<QString, QDBusUnixFileDescriptor> &fdArguments)
+{
+    // Both decoders only construct plain value types, anything else is refused as a whole
+    std::optional<QVariantMap> args = CborCodec::isEncoded(arguments) ? CborCodec::decodeArguments(arguments) : ArgumentDecoder::decode(arguments);
+    if (!args) {
+        qCWarning(KAUTH) << "Refusing request arguments that are malformed or contain unsupported types";
+        return std::nullopt;
+    }
+
+    for (auto [key, value] : fdArguments.asKeyValueRange()) {
+        args->insert(key, QVariant::fromValue(value));
+    }
+
+    return args;
+}
+
+static QByteArray encodeArguments(const QVariantMap &arguments, bool cbor)
+{
+    if (cbor) {
+        // Falls back to QDataStream for types CBOR can't carry, which the helper recognizes
+        if (const std::optional<QByteArray> blob = CborCodec::encodeArguments(arguments)) {
+            return *blob;
+        }
+    }
+
+    QByteArray blob;
+    QDataStream stream(&blob, QIODevice::WriteOnly);
+    stream << arguments;
+    return blob;
+}
+
+static ActionReply decodeReply(const QByteArray &blob)
+{
+    if (!CborCodec::isEncoded(blob)) {
+        return ActionReply::deserialize(blob);
+    }
+
+    const std::optional<ActionReply> reply = CborCodec::decodeReply(blob);
+    if (!reply) {
+        ActionReply errorReply = ActionReply::DBusErrorReply();
+        errorReply.setErrorDescription(QCoreApplication::translate("DBusHelperProxy", "The reply of the helper could not be decoded"));
+        return errorReply;
+    }
+    return *reply;
+}
+
+// Signals for requests with an id the client listens to, besides remoteSignal
+static const std::pair<QLatin1String, const char *> c_helperSignals[] = {
+    {QLatin1String("requestSignal"), SLOT(requestSignalReceived(uint, int, QByteArray))},
+    {QLatin1String("Started"), SLOT(startedReceived(uint))},
+    {QLatin1String("Progress"), SLOT(progressReceived(uint, int))},
+    {QLatin1String("Data"), SLOT(dataReceived(uint, QVariantMap))},
+    {QLatin1String("Log"), SLOT(logReceived(uint, int, QString))},
+};
+
+// Whether data goes through the Data signal unchanged, it's sent as requestSignal blob otherwise
+static bool isPlainDBusMap(const QVariantMap &data)
+{
+    return std::all_of(data.cbegin(), data.cend(), [](const QVariant &value) {
+        switch (value.typeId()) {
+        case QMetaType::Bool:
+        case QMetaType::UChar:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+        case QMetaType::QString:
+        case QMetaType::QByteArray:
+        case QMetaType::QStringList:
+            return true;
+        default:
+            return false;
+        }
+    });
+}
+
+static ActionReply invalidArgumentsReply()
+{
+    ActionReply reply = ActionReply::InvalidActionReply();
+    reply.setErrorDescription(QCoreApplication::translate("DBusHelperProxy", "The arguments of the action could not be decoded"));
+    return reply;
+}
+
+thread_local DBusHelperProxy::Request *DBusHelperProxy::s_currentRequest = nullptr;
+
+DBusHelperProxy::Request::~Request()
+{
+#ifdef Q_OS_LINUX
+    if (stopFd >= 0) {
+        ::close(stopFd);
+    }
+#endif
+}
+
+DBusHelperProxy::RequestScope::RequestScope(Request *request)
+    : m_previous(s_currentRequest)
+{
+    s_currentRequest = request;
+}
+
+DBusHelperProxy::RequestScope::~RequestScope()
+{
+    s_currentRequest = m_previous;
+}
+
 DBusHelperProxy::DBusHelperProxy()
     : responder(nullptr)
-    , m_stopRequest(false)
     , m_busConnection(QDBusConnection::systemBus())
 {
     qDBusRegisterMetaType<QMap<QString, QDBusUnixFileDescriptor>>();
@@ -37,7 +171,6 @@ DBusHelperProxy::DBusHelperProxy()
 
 DBusHelperProxy::DBusHelperProxy(const QDBusConnection &busConnection)
     : responder(nullptr)
-    , m_stopRequest(false)
     , m_busConnection(busConnection)
 {
     qDBusRegisterMetaType<QMap<QString, QDBusUnixFileDescriptor>>();
@@ -45,21 +178,65 @@ DBusHelperProxy::DBusHelperProxy(const QDBusConnection &busConnection)
 
 DBusHelperProxy::~DBusHelperProxy()
 {
+    if (m_control) {
+        m_busConnection.unregisterObject(QStringLiteral("/Control"));
+        m_controlThread.quit();
+        m_controlThread.wait();
+        delete m_control;
+    }
+}
+
+DBusHelperControl::DBusHelperControl(DBusHelperProxy *proxy)
+    : m_proxy(proxy)
+{
+}
+
+void DBusHelperControl::stopAction(const QString &action)
+{
+    m_proxy->requestStop(message().service(), 0, action);
+}
+
+void DBusHelperControl::stopRequest(uint requestId)
+{
+    m_proxy->requestStop(message().service(), requestId, QString());
 }
 
-void DBusHelperProxy::stopAction(const QString &action, const QString &helperID)
+void DBusHelperProxy::stopAction(uint requestId, const QString &action, const QString &helperID)
 {
+    HelperSession &session = m_sessions[helperID];
+    if (auto unsent = session.unsent.find(requestId); unsent != session.unsent.end()) {
+        // Still waiting for the session, it's never sent at all
+        *unsent = true;
+        return;
+    }
+
+    // Helpers built with an older KAuth only take stop requests for a whole action on their main object
+    const bool useControl = session.ready && (session.features & ControlObjectFeature);
+    const bool useRequestId = session.ready && (session.features & RequestIdFeature);
+
     QDBusMessage message;
-    message = QDBusMessage::createMethodCall(helperID, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("stopAction"));
+    message = QDBusMessage::createMethodCall(session.ready ? session.owner : helperID,
+                                             useControl ? QLatin1String("/Control") : QLatin1String("/"),
+                                             QLatin1String("org.kde.kf6auth"),
+                                             useRequestId ? QLatin1String("stopRequest") : QLatin1String("stopAction"));
 
     QList<QVariant> args;
-    args << action;
+    if (useRequestId) {
+        args << requestId;
+    } else {
+        args << action;
+    }
     message.setArguments(args);
 
     m_busConnection.asyncCall(message);
 }
 
-void DBusHelperProxy::executeAction(const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout)
+void DBusHelperProxy::executeAction(uint requestId,
+                                    const QString &action,
+                                    const QString &helperID,
+                                    const DetailsMap &details,
+                                    const QVariantMap &arguments,
+                                    int timeout)
 {
     QMap<QString, QDBusUnixFileDescriptor> fds;
     QVariantMap nonFds;
@@ -71,81 +248,312 @@ void DBusHelperProxy::executeAction(const QString &action, const QString &helper
         }
     }
 
-    QByteArray blob;
-    {
-        QDataStream stream(&blob, QIODevice::WriteOnly);
-        stream << nonFds;
-    }
+    // The arguments are encoded by sendPerformAction() once it's known which encodings the helper supports
+    QList<QVariant> args;
+    args << action << BackendsManager::self().authBackend()->callerID() << BackendsManager::self().authBackend()->backendDetails(details) << nonFds
+         << QVariant::fromValue(fds);
 
-    // on unit tests we won't have a service, but the service will already be running
-    const auto reply = m_busConnection.interface()->startService(helperID);
-    if (!reply.isValid() && !m_busConnection.interface()->isServiceRegistered(helperID)) {
-        ActionReply errorReply = ActionReply::DBusErrorReply();
-        errorReply.setErrorDescription(tr("DBus Backend error: service start %1 failed: %2").arg(helperID, reply.error().message()));
-        Q_EMIT actionPerformed(action, errorReply);
+    m_sessions[helperID].requests.insert(requestId, action);
+
+    performWithSession(requestId, action, helperID, args, timeout, true);
+}
+
+void DBusHelperProxy::performWithSession(uint requestId,
+                                         const QString &action,
+                                         const QString &helperID,
+                                         const QList<QVariant> &args,
+                                         int timeout,
+                                         bool mayRetry)
+{
+    m_sessions[helperID].unsent.insert(requestId, false);
+
+    // None of the bus round-trips below block the calling thread, for a known helper there are none at all
+    withSession(helperID, [this, requestId, action, helperID, args, timeout, mayRetry](const QString &owner, const QString &error) {
+        if (m_sessions[helperID].unsent.take(requestId)) {
+            m_sessions[helperID].requests.remove(requestId);
+            Q_EMIT actionPerformed(requestId, action, ActionReply::UserCancelledReply());
+            return;
+        }
+        if (!error.isEmpty()) {
+            m_sessions[helperID].requests.remove(requestId);
+            ActionReply errorReply = ActionReply::DBusErrorReply();
+            errorReply.setErrorDescription(error);
+            Q_EMIT actionPerformed(requestId, action, errorReply);
+            return;
+        }
+
+        sendPerformAction(requestId, action, helperID, owner, args, timeout, mayRetry);
+    });
+}
+
+void DBusHelperProxy::withSession(const QString &helperID, const std::function<void(const QString &owner, const QString &error)> &callback)
+{
+    HelperSession &session = m_sessions[helperID];
+    if (session.ready) {
+        callback(session.owner, QString());
         return;
     }
 
-    const bool connected = m_busConnection.connect(helperID,
-                                                   QLatin1String("/"),
-                                                   QLatin1String("org.kde.kf6auth"),
-                                                   QLatin1String("remoteSignal"),
-                                                   this,
-                                                   SLOT(remoteSignalReceived(int, QString, QByteArray)));
+    session.waiting.append(callback);
+    if (session.waiting.size() == 1) {
+        setupSession(helperID);
+    }
+}
 
-    // if already connected reply will be false but we won't have an error or a reason to fail
-    if (!connected && m_busConnection.lastError().isValid()) {
-        ActionReply errorReply = ActionReply::DBusErrorReply();
-        errorReply.setErrorDescription(tr("DBus Backend error: connection to helper failed. %1\n(application: %2 helper: %3)")
-                                           .arg(m_busConnection.lastError().message(), qApp->applicationName(), helperID));
-        Q_EMIT actionPerformed(action, errorReply);
+void DBusHelperProxy::setupSession(const QString &helperID)
+{
+    if (!m_serviceWatcher) {
+        m_serviceWatcher = new QDBusServiceWatcher(this);
+        m_serviceWatcher->setConnection(m_busConnection);
+        m_serviceWatcher->setWatchMode(QDBusServiceWatcher::WatchForOwnerChange);
+        connect(m_serviceWatcher, &QDBusServiceWatcher::serviceOwnerChanged, this, &DBusHelperProxy::helperOwnerChanged);
+    }
+    // Watch before looking the owner up, so that no change in between goes unnoticed
+    if (!m_serviceWatcher->watchedServices().contains(helperID)) {
+        m_serviceWatcher->addWatchedService(helperID);
+    }
+
+    const uint setup = ++m_sessions[helperID].setup;
+    resolveHelper(helperID, true, [this, helperID, setup](const QString &owner, const QString &error) {
+        if (m_sessions[helperID].setup != setup) {
+            return;
+        }
+        if (!error.isEmpty()) {
+            finishSessionSetup(helperID, tr("DBus Backend error: service start %1 failed: %2").arg(helperID, error));
+            return;
+        }
+
+        // The unique name of the helper is known already, so this doesn't have to look it up on the bus
+        const bool connected = m_busConnection.connect(owner,
+                                                       QLatin1String("/"),
+                                                       QLatin1String("org.kde.kf6auth"),
+                                                       QLatin1String("remoteSignal"),
+                                                       this,
+                                                       SLOT(remoteSignalReceived(int, QString, QByteArray)));
+
+        // if already connected reply will be false but we won't have an error or a reason to fail
+        if (!connected && m_busConnection.lastError().isValid()) {
+            finishSessionSetup(helperID,
+                               tr("DBus Backend error: connection to helper failed. %1\n(application: %2 helper: %3)")
+                                   .arg(m_busConnection.lastError().message(), qApp->applicationName(), helperID));
+            return;
+        }
+        // Each one is a match rule of its own, the bus only wakes us up for those members
+        for (const auto &[name, slot] : c_helperSignals) {
+            m_busConnection.connect(owner, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), name, this, slot);
+        }
+        m_sessions[helperID].owner = owner;
+
+        QDBusMessage message;
+        message = QDBusMessage::createMethodCall(owner, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("features"));
+
+        auto watcher = new QDBusPendingCallWatcher(m_busConnection.asyncCall(message), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, helperID, setup]() {
+            watcher->deleteLater();
+            if (m_sessions[helperID].setup != setup) {
+                return;
+            }
+
+            // Helpers built with an older KAuth don't know the method and support none of the features
+            const QDBusMessage reply = watcher->reply();
+            m_sessions[helperID].features = reply.type() == QDBusMessage::ReplyMessage ? reply.arguments().value(0).toUInt() : 0;
+            m_sessions[helperID].ready = true;
+            finishSessionSetup(helperID, QString());
+        });
+    });
+}
+
+void DBusHelperProxy::finishSessionSetup(const QString &helperID, const QString &error)
+{
+    HelperSession &session = m_sessions[helperID];
+    const QString owner = session.owner;
+    const auto waiting = std::exchange(session.waiting, {});
+
+    for (const auto &callback : waiting) {
+        callback(owner, error);
+    }
+}
+
+void DBusHelperProxy::helperOwnerChanged(const QString &helperID)
+{
+    auto it = m_sessions.find(helperID);
+    if (it == m_sessions.end()) {
         return;
     }
 
-    QDBusMessage message;
-    message = QDBusMessage::createMethodCall(helperID, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("performAction"));
+    if (!it->ready) {
+        // Changed while the session was set up, the owner found so far may be gone already
+        if (!it->waiting.isEmpty()) {
+            resetSession(*it);
+            setupSession(helperID);
+        }
+        return;
+    }
 
-    QList<QVariant> args;
-    args << action << BackendsManager::self().authBackend()->callerID() << BackendsManager::self().authBackend()->backendDetails(details) << blob
-         << QVariant::fromValue(fds);
-    message.setArguments(args);
+    // The helper quit or was restarted, the next request sets the session up again. Requests still
+    // in flight fail, the helper may have started them. Those sent after it was gone are sent once
+    // more, see sendPerformAction().
+    resetSession(*it);
+}
+
+void DBusHelperProxy::resetSession(HelperSession &session)
+{
+    if (!session.owner.isEmpty()) {
+        m_busConnection.disconnect(session.owner,
+                                   QLatin1String("/"),
+                                   QLatin1String("org.kde.kf6auth"),
+                                   QLatin1String("remoteSignal"),
+                                   this,
+                                   SLOT(remoteSignalReceived(int, QString, QByteArray)));
+        for (const auto &[name, slot] : c_helperSignals) {
+            m_busConnection.disconnect(session.owner, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), name, this, slot);
+        }
+    }
+    session.owner.clear();
+    session.features = 0;
+    session.ready = false;
+}
+
+void DBusHelperProxy::resolveHelper(const QString &helperID, bool activate, const std::function<void(const QString &, const QString &)> &callback)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                          QStringLiteral("/org/freedesktop/DBus"),
+                                                          QStringLiteral("org.freedesktop.DBus"),
+                                                          QStringLiteral("GetNameOwner"));
+    message.setArguments({helperID});
+
+    auto watcher = new QDBusPendingCallWatcher(m_busConnection.asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, helperID, activate, callback]() {
+        watcher->deleteLater();
+
+        const QDBusMessage reply = watcher->reply();
+        if (reply.type() != QDBusMessage::ErrorMessage) {
+            callback(reply.arguments().value(0).toString(), QString());
+            return;
+        }
+
+        // Only activate the helper when nobody owns its name yet, e.g. autotests run it in process
+        if (!activate || watcher->error().type() != QDBusError::NameHasNoOwner) {
+            callback(QString(), reply.errorMessage());
+            return;
+        }
 
-    m_actionsInProgress.push_back(action);
+        QDBusMessage startMessage = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                                   QStringLiteral("/org/freedesktop/DBus"),
+                                                                   QStringLiteral("org.freedesktop.DBus"),
+                                                                   QStringLiteral("StartServiceByName"));
+        startMessage.setArguments({helperID, 0U});
+
+        // Activation can take a while, e.g. when the helper has to be started first
+        auto startWatcher = new QDBusPendingCallWatcher(m_busConnection.asyncCall(startMessage), this);
+        connect(startWatcher, &QDBusPendingCallWatcher::finished, this, [this, startWatcher, helperID, callback]() {
+            startWatcher->deleteLater();
+
+            if (startWatcher->isError()) {
+                callback(QString(), startWatcher->error().message());
+                return;
+            }
+
+            resolveHelper(helperID, false, callback);
+        });
+    });
+}
+
+void DBusHelperProxy::sendPerformAction(uint requestId,
+                                        const QString &action,
+                                        const QString &helperID,
+                                        const QString &owner,
+                                        QList<QVariant> args,
+                                        int timeout,
+                                        bool mayRetry)
+{
+    const auto session = m_sessions.constFind(helperID);
+    const bool useRequestMethod = session != m_sessions.cend() && (session->features & RequestMethodFeature);
+    const bool useCbor = useRequestMethod && (session->features & CborEncodingFeature);
+
+    // A restarted helper may support other encodings, a retry starts from the plain arguments
+    const QList<QVariant> plainArgs = args;
+
+    if (args.value(3).metaType() == QMetaType::fromType<QVariantMap>()) {
+        args[3] = encodeArguments(args.at(3).toMap(), useCbor);
+    }
+
+    QDBusMessage message;
+    if (useRequestMethod) {
+        message = QDBusMessage::createMethodCall(owner, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("performRequest"));
+        // Helpers that don't know about request ids report by action name, see remoteSignalReceived()
+        QVariantMap options = {{QStringLiteral("requestId"), requestId}};
+        if (useCbor) {
+            options.insert(QStringLiteral("encoding"), QStringLiteral("cbor"));
+        }
+        if (session->features & TypedSignalsFeature) {
+            options.insert(QStringLiteral("signals"), QStringLiteral("typed"));
+        }
+        message.setArguments(QList<QVariant>(args) << options);
+    } else {
+        message = QDBusMessage::createMethodCall(owner, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("performAction"));
+        message.setArguments(args);
+    }
 
     QDBusPendingCall pendingCall = m_busConnection.asyncCall(message, timeout);
 
     auto watcher = new QDBusPendingCallWatcher(pendingCall, this);
 
-    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, action, args, message, watcher, timeout]() mutable {
-        watcher->deleteLater();
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, requestId, action, helperID, owner, args, plainArgs, watcher, timeout, useRequestMethod, mayRetry]() mutable {
+                watcher->deleteLater();
 
-        QDBusMessage reply = watcher->reply();
+                const QDBusMessage reply = watcher->reply();
 
-        if (reply.type() == QDBusMessage::ErrorMessage) {
-            if (watcher->error().type() == QDBusError::InvalidArgs) {
-                // For backwards compatibility if helper binary was built with older KAuth version.
-                args.removeAt(args.count() - 2); // remove backend details
-                message.setArguments(args);
-                reply = m_busConnection.call(message, QDBus::Block, timeout);
-                if (reply.type() != QDBusMessage::ErrorMessage) {
+                if (reply.type() == QDBusMessage::ReplyMessage && useRequestMethod) {
+                    // performRequest() only delivers the result here, there is no ActionPerformed signal
+                    m_sessions[helperID].requests.remove(requestId);
+                    Q_EMIT actionPerformed(requestId, action, decodeReply(reply.arguments().value(0).toByteArray()));
                     return;
                 }
-            }
-            ActionReply r = ActionReply::DBusErrorReply();
-            r.setErrorDescription(tr("DBus Backend error: could not contact the helper. "
-                                     "Connection error: %1. Message error: %2")
-                                      .arg(reply.errorMessage(), m_busConnection.lastError().message()));
-            qCWarning(KAUTH) << reply.errorMessage();
 
-            Q_EMIT actionPerformed(action, r);
-        }
-    });
+                if (reply.type() == QDBusMessage::ErrorMessage) {
+                    if (watcher->error().type() == QDBusError::InvalidArgs && !useRequestMethod && args.count() == 5) {
+                        // For backwards compatibility if helper binary was built with older KAuth version.
+                        args.removeAt(args.count() - 2); // remove backend details
+                        sendPerformAction(requestId, action, helperID, owner, args, timeout, mayRetry);
+                        return;
+                    }
+                    if (mayRetry && watcher->error().type() == QDBusError::ServiceUnknown) {
+                        // The helper went away before the owner change was noticed, e.g. it quit after being idle,
+                        // so it never saw the request. Look it up again through its well-known name, starting it if
+                        // need be. NoReply isn't retried, the action may already have run, at least partly.
+                        qCDebug(KAUTH) << "Helper" << owner << "is gone, sending" << action << "once more to" << helperID;
+                        HelperSession &current = m_sessions[helperID];
+                        if (current.ready && current.owner == owner) {
+                            resetSession(current);
+                        }
+                        performWithSession(requestId, action, helperID, plainArgs, timeout, false);
+                        return;
+                    }
+                    m_sessions[helperID].requests.remove(requestId);
+                    ActionReply r = ActionReply::DBusErrorReply();
+                    r.setErrorDescription(tr("DBus Backend error: could not contact the helper. "
+                                             "Connection error: %1. Message error: %2")
+                                              .arg(reply.errorMessage(), m_busConnection.lastError().message()));
+                    qCWarning(KAUTH) << reply.errorMessage();
+
+                    Q_EMIT actionPerformed(requestId, action, r);
+                }
+            });
 }
 
 bool DBusHelperProxy::initHelper(const QString &name)
 {
     new Kf6authAdaptor(this);
 
+    m_control = new DBusHelperControl(this);
+    m_control->moveToThread(&m_controlThread);
+    m_controlThread.setObjectName(QStringLiteral("KAuth helper control"));
+    m_controlThread.start();
+
     if (!m_busConnection.registerService(name)) {
         qCWarning(KAUTH) << "Error registering helper DBus service" << name << m_busConnection.lastError().message();
         return false;
@@ -156,6 +564,11 @@ bool DBusHelperProxy::initHelper(const QString &name)
         return false;
     }
 
+    if (!m_busConnection.registerObject(QLatin1String("/Control"), m_control, QDBusConnection::ExportScriptableSlots)) {
+        qCWarning(KAUTH) << "Error registering helper control DBus object:" << m_busConnection.lastError().message();
+        return false;
+    }
+
     m_name = name;
 
     return true;
@@ -164,20 +577,122 @@ bool DBusHelperProxy::initHelper(const QString &name)
 void DBusHelperProxy::setHelperResponder(QObject *o)
 {
     responder = o;
+    m_invokers.clear();
+
+    if (!o) {
+        return;
+    }
+
+    // Resolve the action slots once, performAction() only has to look the action up. initHelper()
+    // has set m_name by now, the slot foo_bar implements the action <helper id>.foo.bar
+    const QMetaObject *metaObj = o->metaObject();
+    const int classInfoIndex = metaObj->indexOfClassInfo("KAuth.Threaded");
+    const bool threadedResponder = classInfoIndex >= 0 && qstrcmp(metaObj->classInfo(classInfoIndex).value(), "true") == 0;
+
+    for (int i = 0; i < metaObj->methodCount(); ++i) {
+        const QMetaMethod method = metaObj->method(i);
+        if (method.methodType() == QMetaMethod::Signal || method.parameterCount() != 1 || method.parameterMetaType(0) != QMetaType::fromType<QVariantMap>()) {
+            continue;
+        }
+
+        Invoker invoker;
+        invoker.method = method;
+        if (isFutureReplyType(method.returnMetaType(), method.typeName())) {
+            invoker.future = true;
+        } else if (!isActionReplyType(method.returnMetaType(), method.typeName())) {
+            continue;
+        }
+        invoker.threaded = threadedResponder || qstrcmp(method.tag(), "KAUTH_THREADED") == 0;
+
+        const QString action = m_name + QLatin1Char('.') + QString::fromLatin1(method.name()).replace(QLatin1Char('_'), QLatin1Char('.'));
+        m_invokers.insert(action, invoker);
+    }
+}
+
+DBusHelperProxy::HelperSession *DBusHelperProxy::sessionForOwner(const QString &owner)
+{
+    for (HelperSession &session : m_sessions) {
+        if (session.owner == owner) {
+            return &session;
+        }
+    }
+    return nullptr;
 }
 
 void DBusHelperProxy::remoteSignalReceived(int t, const QString &action, QByteArray blob)
 {
-    SignalType type = static_cast<SignalType>(t);
+    // Helpers built with an older KAuth don't know about request ids. Their requests for
+    // the same action finish in order, so this is about the oldest one in progress.
+    uint requestId = 0;
+    if (const HelperSession *session = sessionForOwner(message().service())) {
+        for (auto [id, requestAction] : session->requests.asKeyValueRange()) {
+            if (requestAction == action) {
+                requestId = id;
+                break;
+            }
+        }
+    }
+
+    handleRequestSignal(requestId, action, static_cast<SignalType>(t), blob);
+}
+
+std::optional<QString> DBusHelperProxy::actionForSignal(uint requestId)
+{
+    const HelperSession *session = sessionForOwner(message().service());
+    if (!session || !session->requests.contains(requestId)) {
+        return std::nullopt;
+    }
+    return session->requests.value(requestId);
+}
+
+void DBusHelperProxy::requestSignalReceived(uint requestId, int t, QByteArray blob)
+{
+    if (const std::optional<QString> action = actionForSignal(requestId)) {
+        handleRequestSignal(requestId, *action, static_cast<SignalType>(t), blob);
+    }
+}
+
+void DBusHelperProxy::startedReceived(uint requestId)
+{
+    if (const std::optional<QString> action = actionForSignal(requestId)) {
+        Q_EMIT actionStarted(requestId, *action);
+    }
+}
+
+void DBusHelperProxy::progressReceived(uint requestId, int percent)
+{
+    if (const std::optional<QString> action = actionForSignal(requestId)) {
+        Q_EMIT progressStep(requestId, *action, percent);
+    }
+}
+
+void DBusHelperProxy::dataReceived(uint requestId, const QVariantMap &data)
+{
+    if (const std::optional<QString> action = actionForSignal(requestId)) {
+        Q_EMIT progressStepData(requestId, *action, data);
+    }
+}
+
+void DBusHelperProxy::logReceived(uint requestId, int level, const QString &message)
+{
+    if (actionForSignal(requestId)) {
+        debugMessageReceived(level, message);
+    }
+}
+
+void DBusHelperProxy::handleRequestSignal(uint requestId, const QString &action, SignalType type, QByteArray blob)
+{
     QDataStream stream(&blob, QIODevice::ReadOnly);
 
     if (type == ActionStarted) {
-        Q_EMIT actionStarted(action);
+        Q_EMIT actionStarted(requestId, action);
     } else if (type == ActionPerformed) {
-        ActionReply reply = ActionReply::deserialize(blob);
+        ActionReply reply = decodeReply(blob);
 
-        m_actionsInProgress.removeOne(action);
-        Q_EMIT actionPerformed(action, reply);
+        if (HelperSession *session = sessionForOwner(message().service())) {
+            session->requests.remove(requestId);
+        }
+        Q_EMIT actionPerformed(requestId, action, reply);
     } else if (type == DebugMessage) {
         int level;
         QString message;
@@ -189,148 +704,487 @@ void DBusHelperProxy::remoteSignalReceived(int t, const QString &action, QByteAr
         int step;
         stream >> step;
 
-        Q_EMIT progressStep(action, step);
+        Q_EMIT progressStep(requestId, action, step);
     } else if (type == ProgressStepData) {
         QVariantMap data;
         stream >> data;
-        Q_EMIT progressStepData(action, data);
+        Q_EMIT progressStepData(requestId, action, data);
     }
 }
 
+uint DBusHelperProxy::features() const
+{
+    return ControlObjectFeature | RequestMethodFeature | RequestIdFeature | CborEncodingFeature | TypedSignalsFeature;
+}
+
 void DBusHelperProxy::stopAction(const QString &action)
 {
-    Q_UNUSED(action)
-    //#warning FIXME: The stop request should be action-specific rather than global
-    m_stopRequest = true;
+    requestStop(message().service(), 0, action);
+}
+
+void DBusHelperProxy::requestStop(const QString &caller, uint requestId, const QString &action)
+{
+    QMutexLocker locker(&m_requestsMutex);
+
+    // Only the process that started a request may stop it
+    for (const auto &request : std::as_const(m_requests)) {
+        if (request->caller != caller || (requestId ? request->id != requestId : request->action != action)) {
+            continue;
+        }
+
+        request->stopRequested = true;
+        // The user may still be looking at the authentication dialog, withdraw it
+        request->authorization.cancel();
+#ifdef Q_OS_LINUX
+        if (request->stopFd >= 0) {
+            const quint64 value = 1;
+            if (::write(request->stopFd, &value, sizeof(value)) != sizeof(value)) {
+                qCWarning(KAUTH) << "Could not signal the stop file descriptor of" << request->action << "request" << request->id;
+            }
+        }
+#endif
+    }
 }
 
 bool DBusHelperProxy::hasToStopAction()
 {
-    QEventLoop loop;
-    loop.processEvents(QEventLoop::AllEvents);
+    // Stop requests are delivered by the control thread, except those of clients built with an older
+    // KAuth. They send stopAction() to the main object, which only this thread serves.
+    Request *request = s_currentRequest;
+    if (request && request->replyWithSignal && QThread::currentThread() == thread()
+        && (!m_lastEventsProcessed.isValid() || m_lastEventsProcessed.hasExpired(50))) {
+        QEventLoop loop;
+        loop.processEvents(QEventLoop::AllEvents);
+        m_lastEventsProcessed.start();
+    }
 
-    return m_stopRequest;
+    return request && request->stopRequested;
 }
 
-bool DBusHelperProxy::isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details)
+int DBusHelperProxy::stopFileDescriptor()
+{
+#ifdef Q_OS_LINUX
+    Request *request = s_currentRequest;
+    if (!request) {
+        return -1;
+    }
+
+    QMutexLocker locker(&request->proxy->m_requestsMutex);
+    if (request->stopFd < 0) {
+        request->stopFd = eventfd(request->stopRequested ? 1 : 0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+    return request->stopFd;
+#else
+    return -1;
+#endif
+}
+
+QFuture<bool> DBusHelperProxy::authorizeRequest(const std::shared_ptr<Request> &request, const QByteArray &callerID, const QVariantMap &details)
 {
     Q_UNUSED(callerID); // this only exists for the benefit of the mac backend. We obtain our callerID from dbus!
-    return BackendsManager::self().authBackend()->isCallerAuthorized(action, message().service().toUtf8(), details);
+    AuthBackend *backend = BackendsManager::self().authBackend();
+    // A caller the backend still remembers is answered right away, without waiting for its credentials
+    if (backend->isCallerAuthorizationCached(request->action, request->caller.toUtf8(), details)) {
+        return QtFuture::makeReadyValueFuture(true);
+    }
+    if (request->credentialsReply.isFinished()) {
+        return backend->isCallerAuthorizedAsync(request->action, request->caller.toUtf8(), details, requestCredentials(request.get()));
+    }
+
+    // Don't block the bus thread on the credentials, the backend gets the ones the slot sees
+    auto promise = std::make_shared<QPromise<bool>>();
+    promise->start();
+
+    auto *watcher = new QDBusPendingCallWatcher(request->credentialsReply, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, promise, request, callerID, details]() {
+        watcher->deleteLater();
+
+        // Stopped while the credentials were looked up
+        if (promise->isCanceled()) {
+            promise->finish();
+            return;
+        }
+
+        QFuture<bool> authorized = authorizeRequest(request, callerID, details);
+
+        // Canceling the answer withdraws the check
+        forwardCancellation(promise->future(), this, authorized);
+
+        authorized
+            .then(this,
+                  [promise](bool result) {
+                      promise->addResult(result);
+                      promise->finish();
+                  })
+            .onCanceled(this, [promise]() {
+                // The backend gave up, handleRequest() tells that apart from a stop
+                promise->future().cancel();
+                promise->finish();
+            });
+    });
+
+    return promise->future();
 }
 
 QByteArray DBusHelperProxy::performAction(const QString &action,
                                           const QByteArray &callerID,
                                           const QVariantMap &details,
-                                          QByteArray arguments,
+                                          const QByteArray &arguments,
                                           const QMap<QString, QDBusUnixFileDescriptor> &fdArguments)
+{
+    // Clients built with an older KAuth take the reply from the ActionPerformed signal
+    return handleRequest(action, callerID, details, arguments, fdArguments, 0, true, false, false);
+}
+
+QByteArray DBusHelperProxy::performRequest(const QString &action,
+                                           const QByteArray &callerID,
+                                           const QVariantMap &details,
+                                           const QByteArray &arguments,
+                                           const QMap<QString, QDBusUnixFileDescriptor> &fdArguments,
+                                           const QVariantMap &options)
+{
+    // Unknown options are ignored, so that clients can pass new ones to older helpers
+    const uint requestId = options.value(QStringLiteral("requestId")).toUInt();
+    const bool cborReply = options.value(QStringLiteral("encoding")).toString() == QLatin1String("cbor");
+    // Without a request id the caller couldn't tell the typed signals of its requests apart
+    const bool typedSignals = requestId && options.value(QStringLiteral("signals")).toString() == QLatin1String("typed");
+    return handleRequest(action, callerID, details, arguments, fdArguments, requestId, false, cborReply, typedSignals);
+}
+
+QByteArray DBusHelperProxy::handleRequest(const QString &action,
+                                          const QByteArray &callerID,
+                                          const QVariantMap &details,
+                                          const QByteArray &arguments,
+                                          const QMap<QString, QDBusUnixFileDescriptor> &fdArguments,
+                                          uint requestId,
+                                          bool replyWithSignal,
+                                          bool cborReply,
+                                          bool typedSignals)
 {
     if (!responder) {
         return ActionReply::NoResponderReply().serialized();
     }
 
-    if (!m_currentAction.isEmpty()) {
-        return ActionReply::HelperBusyReply().serialized();
+    auto invokerIt = m_invokers.constFind(action);
+    if (invokerIt == m_invokers.cend() && !action.startsWith(m_name + QLatin1Char('.'))) {
+        // Actions used to be accepted without the helper id in front
+        invokerIt = m_invokers.constFind(m_name + QLatin1Char('.') + action);
     }
+    const Invoker invoker = invokerIt != m_invokers.cend() ? *invokerIt : Invoker();
 
-    // Make sure we don't try restoring gui variants, in particular QImage/QPixmap/QIcon are super dangerous
-    // since they end up calling the image loaders and thus are a vector for crashing → executing code
-    auto origMetaTypeGuiHelper = qMetaTypeGuiHelper;
-    qMetaTypeGuiHelper = nullptr;
+    auto request = std::make_shared<Request>();
+    request->action = action;
+    request->caller = message().service();
+    request->id = requestId;
+    request->proxy = this;
+    request->replyWithSignal = replyWithSignal;
+    request->cborReply = cborReply;
+    request->typedSignals = typedSignals;
 
-    QVariantMap args;
-    QDataStream s(&arguments, QIODevice::ReadOnly);
-    s >> args;
+    QTimer *timer = responder->property("__KAuth_Helper_Shutdown_Timer").value<QTimer *>();
+    timer->stop();
 
-    for (auto [key, value] : fdArguments.asKeyValueRange()) {
-        args.insert(key, QVariant::fromValue(value));
+    // Further requests may arrive through the nested event loops below, each one runs with its own context
+    {
+        QMutexLocker locker(&m_requestsMutex);
+        m_requests.append(request);
     }
 
-    qMetaTypeGuiHelper = origMetaTypeGuiHelper;
-
-    m_currentAction = action;
-    Q_EMIT remoteSignal(ActionStarted, action, QByteArray());
+    if (request->typedSignals) {
+        emitTypedSignal(request.get(), QStringLiteral("Started"), {});
+    } else {
+        emitRequestSignal(request.get(), ActionStarted, QByteArray());
+    }
     QEventLoop e;
     e.processEvents(QEventLoop::AllEvents);
 
-    ActionReply retVal;
+    // Refuse unknown actions before looking at anything the caller sent
+    if (!invoker.method.isValid()) {
+        return finishRequest(request, ActionReply::NoSuchActionReply());
+    }
 
-    QTimer *timer = responder->property("__KAuth_Helper_Shutdown_Timer").value<QTimer *>();
-    timer->stop();
+    // Looked up once, both the backend and the slot identify the caller by them
+    QDBusMessage credentialsCall = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                                  QStringLiteral("/org/freedesktop/DBus"),
+                                                                  QStringLiteral("org.freedesktop.DBus"),
+                                                                  QStringLiteral("GetConnectionCredentials"));
+    credentialsCall << request->caller;
+    request->credentialsReply = m_busConnection.asyncCall(credentialsCall);
+
+    const QFuture<bool> authorized = authorizeRequest(request, callerID, details);
+    if (!authorized.isFinished()) {
+        // The user may be typing a password for a while, meanwhile the bus thread keeps serving other callers
+        deferReply(request.get());
+        {
+            QMutexLocker locker(&m_requestsMutex);
+            request->authorization = authorized;
+        }
+        if (request->stopRequested) {
+            // Stopped while the backend was asked, requestStop() didn't see the future yet
+            request->authorization.cancel();
+        }
 
-    if (isCallerAuthorized(action, callerID, details)) {
-        QString slotname = action;
-        if (slotname.startsWith(m_name + QLatin1Char('.'))) {
-            slotname = slotname.right(slotname.length() - m_name.length() - 1);
-        }
-
-        slotname.replace(QLatin1Char('.'), QLatin1Char('_'));
-
-        // For legacy reasons we could be dealing with ActionReply types (i.e.
-        // `using namespace KAuth`). Since Qt type names are verbatim this would
-        // mismatch a return type that is called 'KAuth::ActionReply' and
-        // vice versa. This effectively required client code to always 'use' the
-        // namespace as otherwise we'd not be able to call into it.
-        // To support both scenarios we now dynamically determine what kind of return type
-        // we deal with and call Q_RETURN_ARG either with or without namespace.
-        const auto metaObj = responder->metaObject();
-        const QString slotSignature(slotname + QStringLiteral("(QVariantMap)"));
-        const QMetaMethod method = metaObj->method(metaObj->indexOfMethod(qPrintable(slotSignature)));
-        if (method.isValid()) {
-            const auto needle = "KAuth::";
-            bool success = false;
-            if (strncmp(needle, method.typeName(), strlen(needle)) == 0) {
-                success = method.invoke(responder, Qt::DirectConnection, Q_RETURN_ARG(KAuth::ActionReply, retVal), Q_ARG(QVariantMap, args));
-            } else {
-                success = method.invoke(responder, Qt::DirectConnection, Q_RETURN_ARG(ActionReply, retVal), Q_ARG(QVariantMap, args));
-            }
-            if (!success) {
-                retVal = ActionReply::NoSuchActionReply();
-            }
-        } else {
-            retVal = ActionReply::NoSuchActionReply();
+        authorized
+            .then(this,
+                  [this, request, invoker, arguments, fdArguments](bool authorized) {
+                      if (!authorized) {
+                          finishRequest(request, ActionReply::AuthorizationDeniedReply());
+                          return;
+                      }
+                      dispatchRequest(request, invoker, arguments, fdArguments);
+                  })
+            .onCanceled(this, [this, request]() {
+                // Either the caller gave up or the backend couldn't ask anymore
+                finishRequest(request, request->stopRequested ? ActionReply::UserCancelledReply() : ActionReply::AuthorizationDeniedReply());
+            });
+        return QByteArray();
+    }
+
+    // The backend remembered the caller, or answered without asking anyone
+    if (!authorized.result()) {
+        return finishRequest(request, ActionReply::AuthorizationDeniedReply());
+    }
+
+    const std::optional<QByteArray> blob = dispatchRequest(request, invoker, arguments, fdArguments);
+    e.processEvents(QEventLoop::AllEvents);
+
+    return blob.value_or(QByteArray());
+}
+
+void DBusHelperProxy::deferReply(Request *request)
+{
+    // Only possible while handling the call, later on the message is already known
+    if (request->message.type() == QDBusMessage::MethodCallMessage) {
+        return;
+    }
+    setDelayedReply(true);
+    request->message = message();
+}
+
+std::optional<QByteArray> DBusHelperProxy::dispatchRequest(const std::shared_ptr<Request> &request,
+                                                           const Invoker &invoker,
+                                                           const QByteArray &arguments,
+                                                           const QMap<QString, QDBusUnixFileDescriptor> &fdArguments)
+{
+    if (invoker.threaded) {
+        // The reply is sent once the worker is done, meanwhile the bus thread keeps serving other callers
+        deferReply(request.get());
+
+        // Decoded by the worker as well, large arguments don't hold up the bus thread
+        threadPool()->start([this, request, invoker, arguments, fdArguments]() {
+            const std::optional<QVariantMap> args = decodeArguments(arguments, fdArguments);
+            const QFuture<ActionReply> reply = args ? invokeResponder(request.get(), invoker, *args) : QtFuture::makeReadyValueFuture(invalidArgumentsReply());
+            QMetaObject::invokeMethod(
+                this,
+                [this, request, reply]() {
+                    watchReply(request, reply);
+                },
+                Qt::QueuedConnection);
+        });
+        return std::nullopt;
+    }
+
+    const std::optional<QVariantMap> args = decodeArguments(arguments, fdArguments);
+    if (!args) {
+        return finishRequest(request, invalidArgumentsReply());
+    }
+
+    const QFuture<ActionReply> reply = invokeResponder(request.get(), invoker, *args);
+    if (!reply.isFinished()) {
+        // The slot is waiting on something else, answer once its future resolves
+        deferReply(request.get());
+        watchReply(request, reply);
+        return std::nullopt;
+    }
+
+    return finishRequest(request, replyOf(reply));
+}
+
+QFuture<ActionReply> DBusHelperProxy::invokeResponder(Request *request, const Invoker &invoker, const QVariantMap &arguments)
+{
+    RequestScope scope(request);
+
+    // The slot's signature was checked in setHelperResponder(), call it directly
+    QVariantMap args = arguments;
+    const int index = invoker.method.methodIndex();
+    if (invoker.future) {
+        QFuture<ActionReply> future;
+        void *argv[] = {&future, &args};
+        if (QMetaObject::metacall(responder, QMetaObject::InvokeMetaMethod, index, argv) < 0) {
+            return future;
         }
     } else {
-        retVal = ActionReply::AuthorizationDeniedReply();
+        ActionReply retVal;
+        void *argv[] = {&retVal, &args};
+        if (QMetaObject::metacall(responder, QMetaObject::InvokeMetaMethod, index, argv) < 0) {
+            return QtFuture::makeReadyValueFuture(retVal);
+        }
     }
 
-    timer->start();
+    return QtFuture::makeReadyValueFuture(ActionReply::NoSuchActionReply());
+}
 
-    Q_EMIT remoteSignal(ActionPerformed, action, retVal.serialized());
-    e.processEvents(QEventLoop::AllEvents);
-    m_currentAction.clear();
-    m_stopRequest = false;
+void DBusHelperProxy::watchReply(const std::shared_ptr<Request> &request, const QFuture<ActionReply> &reply)
+{
+    auto watcher = new QFutureWatcher<ActionReply>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, request, watcher]() {
+        watcher->deleteLater();
+
+        finishRequest(request, replyOf(watcher->future()));
+    });
+    watcher->setFuture(reply);
+}
+
+ActionReply DBusHelperProxy::replyOf(const QFuture<ActionReply> &future)
+{
+    if (future.isCanceled() || future.resultCount() == 0) {
+        // Don't leave the caller waiting for a result that will never come
+        ActionReply reply = ActionReply::HelperErrorReply();
+        reply.setErrorDescription(tr("The helper did not return a reply for this action"));
+        return reply;
+    }
+
+    return future.result();
+}
+
+QByteArray DBusHelperProxy::finishRequest(const std::shared_ptr<Request> &request, const ActionReply &reply)
+{
+    // Replies with data CBOR can't carry go out as QDataStream blob, the client tells them apart
+    const QByteArray blob = request->cborReply ? CborCodec::encodeReply(reply).value_or(reply.serialized()) : reply.serialized();
+    if (request->replyWithSignal) {
+        emitRequestSignal(request.get(), ActionPerformed, blob);
+    }
+
+    if (request->message.type() == QDBusMessage::MethodCallMessage) {
+        m_busConnection.send(request->message.createReply(QVariant(blob)));
+    }
 
-    return retVal.serialized();
+    QMutexLocker locker(&m_requestsMutex);
+    m_requests.removeOne(request);
+    if (m_requests.isEmpty()) {
+        responder->property("__KAuth_Helper_Shutdown_Timer").value<QTimer *>()->start();
+    }
+
+    return blob;
+}
+
+void DBusHelperProxy::emitRequestSignal(Request *request, SignalType type, const QByteArray &blob)
+{
+    // Debug messages may also be sent outside of any request, e.g. during startup
+    const QString action = request ? request->action : QString();
+    const QString caller = request ? request->caller : QString();
+    const uint requestId = request ? request->id : 0;
+
+    if (QThread::currentThread() != thread()) {
+        // Sent from a threaded slot, signals go out in order from the bus thread
+        QMetaObject::invokeMethod(
+            this,
+            [this, caller, requestId, type, action, blob]() {
+                sendRemoteSignal(caller, requestId, type, action, blob);
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+
+    sendRemoteSignal(caller, requestId, type, action, blob);
+}
+
+void DBusHelperProxy::sendRemoteSignal(const QString &caller, uint requestId, SignalType type, const QString &action, const QByteArray &blob)
+{
+    if (caller.isEmpty()) {
+        Q_EMIT remoteSignal(type, action, blob);
+        return;
+    }
+
+    if (requestId) {
+        QDBusMessage signal =
+            QDBusMessage::createTargetedSignal(caller, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("requestSignal"));
+        signal << requestId << int(type) << blob;
+        m_busConnection.send(signal);
+        return;
+    }
+
+    // Only wake up the process that made the request. The bus delivers a signal with a destination
+    // to that peer whatever its match rules are, so clients built with an older KAuth still get it.
+    QDBusMessage signal = QDBusMessage::createTargetedSignal(caller, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), QLatin1String("remoteSignal"));
+    signal << int(type) << action << blob;
+    m_busConnection.send(signal);
+}
+
+void DBusHelperProxy::emitTypedSignal(Request *request, const QString &name, const QVariantList &arguments)
+{
+    QDBusMessage signal = QDBusMessage::createTargetedSignal(request->caller, QLatin1String("/"), QLatin1String("org.kde.kf6auth"), name);
+    signal.setArguments(QVariantList{request->id} + arguments);
+
+    if (QThread::currentThread() != thread()) {
+        // Same as in emitRequestSignal(), keeps them in order with the reply
+        QMetaObject::invokeMethod(
+            this,
+            [this, signal]() {
+                m_busConnection.send(signal);
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+
+    m_busConnection.send(signal);
+}
+
+QThreadPool *DBusHelperProxy::threadPool()
+{
+    if (!m_threadPool) {
+        // Bounded by the number of cores, further requests wait for a free worker
+        m_threadPool = new QThreadPool(this);
+    }
+    return m_threadPool;
 }
 
 void DBusHelperProxy::sendDebugMessage(int level, const char *msg)
 {
+    Request *request = s_currentRequest;
+    if (request && request->typedSignals) {
+        request->proxy->emitTypedSignal(request, QStringLiteral("Log"), {level, QString::fromLocal8Bit(msg)});
+        return;
+    }
+
     QByteArray blob;
     QDataStream stream(&blob, QIODevice::WriteOnly);
 
     stream << level << QString::fromLocal8Bit(msg);
 
-    Q_EMIT remoteSignal(DebugMessage, m_currentAction, blob);
+    (request ? request->proxy : this)->emitRequestSignal(request, DebugMessage, blob);
 }
 
 void DBusHelperProxy::sendProgressStep(int step)
 {
+    Request *request = s_currentRequest;
+    if (request && request->typedSignals) {
+        request->proxy->emitTypedSignal(request, QStringLiteral("Progress"), {step});
+        return;
+    }
+
     QByteArray blob;
     QDataStream stream(&blob, QIODevice::WriteOnly);
 
     stream << step;
 
-    Q_EMIT remoteSignal(ProgressStepIndicator, m_currentAction, blob);
+    (request ? request->proxy : this)->emitRequestSignal(request, ProgressStepIndicator, blob);
 }
 
 void DBusHelperProxy::sendProgressStepData(const QVariantMap &data)
 {
+    Request *request = s_currentRequest;
+    if (request && request->typedSignals && isPlainDBusMap(data)) {
+        request->proxy->emitTypedSignal(request, QStringLiteral("Data"), {data});
+        return;
+    }
+
     QByteArray blob;
     QDataStream stream(&blob, QIODevice::WriteOnly);
 
     stream << data;
 
-    Q_EMIT remoteSignal(ProgressStepData, m_currentAction, blob);
+    (request ? request->proxy : this)->emitRequestSignal(request, ProgressStepData, blob);
 }
 
 void debugMessageReceived(int t, const QString &message)
@@ -357,11 +1211,56 @@ void debugMessageReceived(int t, const QString &message)
 
 int DBusHelperProxy::callerUid() const
 {
-    QDBusConnectionInterface *iface = connection().interface();
-    if (!iface) {
-        return -1;
+    return callerCredentials().uid();
+}
+
+HelperSupport::CallerCredentials DBusHelperProxy::callerCredentials() const
+{
+    Request *request = s_currentRequest;
+    if (!request) {
+        return HelperSupport::CallerCredentials();
     }
-    return iface->serviceUid(message().service());
+    return requestCredentials(request);
+}
+
+HelperSupport::CallerCredentials DBusHelperProxy::requestCredentials(Request *request)
+{
+    // Don't hold the lock while waiting, the reply is delivered independently of it
+    request->credentialsReply.waitForFinished();
+
+    QMutexLocker locker(&request->proxy->m_requestsMutex);
+    if (request->credentials) {
+        return *request->credentials;
+    }
+
+    HelperSupport::CallerCredentials credentials;
+    if (request->credentialsReply.isError()) {
+        qCWarning(KAUTH) << "Could not get the credentials of" << request->caller << request->credentialsReply.error().message();
+    } else {
+        const QVariantMap map = request->credentialsReply.value();
+        if (const QVariant uid = map.value(QStringLiteral("UnixUserID")); uid.isValid()) {
+            credentials.setUid(uid.toInt());
+        }
+        if (const QVariant pid = map.value(QStringLiteral("ProcessID")); pid.isValid()) {
+            credentials.setPid(pid.toUInt());
+        }
+        if (const QVariant gids = map.value(QStringLiteral("UnixGroupIDs")); gids.isValid()) {
+            credentials.setGids(qdbus_cast<QList<uint>>(gids));
+        }
+        request->pidfd = map.value(QStringLiteral("ProcessFD")).value<QDBusUnixFileDescriptor>();
+        if (request->pidfd.isValid()) {
+            credentials.setPidfd(request->pidfd.fileDescriptor());
+        }
+        QByteArray securityLabel = map.value(QStringLiteral("LinuxSecurityLabel")).toByteArray();
+        // The label is sent including its terminating NUL
+        if (securityLabel.endsWith('\0')) {
+            securityLabel.chop(1);
+        }
+        credentials.setSecurityLabel(securityLabel);
+    }
+
+    request->credentials = credentials;
+    return credentials;
 }
 
 } // namespace KAuth
@@ -14,22 +14,124 @@
 
 #include <QDBusConnection>
 #include <QDBusContext>
+#include <QDBusPendingReply>
 #include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QThread>
 #include <QVariant>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+
+class QDBusServiceWatcher;
+class QThreadPool;
+
 namespace KAuth
 {
+class DBusHelperProxy;
+
+// Receives stop requests on a thread of its own, so they reach requests whose slot
+// is busy on the main thread without it having to run the event loop
+class DBusHelperControl : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kf6auth")
+
+public:
+    explicit DBusHelperControl(DBusHelperProxy *proxy);
+
+public Q_SLOTS:
+    Q_SCRIPTABLE void stopAction(const QString &action);
+    Q_SCRIPTABLE void stopRequest(uint requestId);
+
+private:
+    DBusHelperProxy *const m_proxy;
+};
+
 class DBusHelperProxy : public HelperProxy, protected QDBusContext
 {
     Q_OBJECT
     Q_PLUGIN_METADATA(IID "org.kde.DBusHelperProxy")
     Q_INTERFACES(KAuth::HelperProxy)
 
+    // State of a single performAction() call. Several of them can be in flight
+    // at once, e.g. while one request waits for the user to authenticate.
+    struct Request {
+        ~Request();
+
+        QString action;
+        QString caller; // unique bus name of the calling process
+        uint id = 0; // chosen by the caller, 0 when it didn't pass one
+        std::atomic<bool> stopRequested = false;
+        int stopFd = -1; // eventfd signalled on stop, created on demand under m_requestsMutex
+        DBusHelperProxy *proxy = nullptr; // the proxy the request arrived on
+        bool replyWithSignal = false; // also send the reply as ActionPerformed signal, for older clients
+        bool cborReply = false; // the caller understands CborCodec replies
+        bool typedSignals = false; // the caller listens to Started, Progress, Data and Log instead of requestSignal
+        QDBusMessage message; // only set when the reply is sent later on
+        QFuture<bool> authorization; // pending authorization, canceled on stop, under m_requestsMutex
+        QDBusPendingReply<QVariantMap> credentialsReply; // GetConnectionCredentials, sent once the action is known
+        std::optional<HelperSupport::CallerCredentials> credentials; // parsed on first use, under m_requestsMutex
+        QDBusUnixFileDescriptor pidfd; // keeps credentials->pidfd open
+    };
+
+    // Makes a request the current one of this thread for HelperSupport calls while its slot runs
+    class RequestScope
+    {
+    public:
+        explicit RequestScope(Request *request);
+        ~RequestScope();
+
+    private:
+        Request *const m_previous;
+    };
+
+    static thread_local Request *s_currentRequest;
+
+    // A responder slot implementing an action, resolved once in setHelperResponder()
+    struct Invoker {
+        QMetaMethod method;
+        bool future = false; // returns QFuture<ActionReply> rather than ActionReply
+        bool threaded = false; // runs on the thread pool
+    };
+
     QObject *responder;
     QString m_name;
-    QString m_currentAction;
-    bool m_stopRequest;
-    QList<QString> m_actionsInProgress;
+    QHash<QString, Invoker> m_invokers; // by action id
+    QList<std::shared_ptr<Request>> m_requests;
+    QMutex m_requestsMutex; // m_requests is also read from the control thread
+    QThreadPool *m_threadPool = nullptr;
+    QThread m_controlThread;
+    DBusHelperControl *m_control = nullptr;
+    QElapsedTimer m_lastEventsProcessed; // see hasToStopAction()
+    // Optional parts of the protocol a helper supports, so that clients can rely on them
+    enum Feature : uint {
+        ControlObjectFeature = 0x1, // stopAction() is served by the /Control object
+        RequestMethodFeature = 0x2, // performRequest() is available, its reply is only sent as return value
+        RequestIdFeature = 0x4, // performRequest() takes a "requestId" option, used by requestSignal and stopRequest()
+        CborEncodingFeature = 0x8, // performRequest() takes CborCodec arguments, and replies that way given "encoding": "cbor"
+        TypedSignalsFeature = 0x10, // given "signals": "typed", performRequest() reports through Started, Progress, Data and Log
+    };
+
+    // What the client side knows about a helper it talks to
+    struct HelperSession {
+        QString owner; // unique bus name of the helper
+        bool ready = false; // owner is resolved, subscribed to and its features are known
+        uint setup = 0; // bumped whenever the setup starts over, answers to an older one are dropped
+        uint features = 0;
+        QMap<uint, QString> requests; // actions in progress by request id, oldest first
+        QHash<uint, bool> unsent; // requests waiting for the session to become ready, true once stopped
+        // Requests waiting for the session to become ready, called with the owner or an error
+        QList<std::function<void(const QString &owner, const QString &error)>> waiting;
+    };
+
+    QHash<QString, HelperSession> m_sessions; // by helper ID
+    QDBusServiceWatcher *m_serviceWatcher = nullptr;
     QDBusConnection m_busConnection;
 
     enum SignalType {
@@ -46,9 +148,13 @@ public:
 
     ~DBusHelperProxy() override;
 
-    virtual void
-    executeAction(const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout = -1) override;
-    void stopAction(const QString &action, const QString &helperID) override;
+    void executeAction(uint requestId,
+                       const QString &action,
+                       const QString &helperID,
+                       const DetailsMap &details,
+                       const QVariantMap &arguments,
+                       int timeout = -1) override;
+    void stopAction(uint requestId, const QString &action, const QString &helperID) override;
 
     bool initHelper(const QString &name) override;
     void setHelperResponder(QObject *o) override;
@@ -56,25 +162,100 @@ public:
     void sendDebugMessage(int level, const char *msg) override;
     void sendProgressStep(int step) override;
     void sendProgressStepData(const QVariantMap &data) override;
+    int stopFileDescriptor() override;
 
     int callerUid() const override;
+    HelperSupport::CallerCredentials callerCredentials() const override;
 
 public Q_SLOTS:
+    uint features() const;
     void stopAction(const QString &action);
     QByteArray performAction(const QString &action,
                              const QByteArray &callerID,
                              const QVariantMap &details,
-                             QByteArray arguments,
+                             const QByteArray &arguments,
                              const QMap<QString, QDBusUnixFileDescriptor> &fdArguments);
+    QByteArray performRequest(const QString &action,
+                              const QByteArray &callerID,
+                              const QVariantMap &details,
+                              const QByteArray &arguments,
+                              const QMap<QString, QDBusUnixFileDescriptor> &fdArguments,
+                              const QVariantMap &options);
 
 Q_SIGNALS:
     void remoteSignal(int type, const QString &action, const QByteArray &blob); // This signal is sent from the helper to the app
+    void requestSignal(uint requestId, int type, const QByteArray &blob); // Same, for requests with an id, only sent to their caller
+    // Same again, one signal per kind without a nested blob, for callers asking for it
+    void Started(uint requestId);
+    void Progress(uint requestId, int percent);
+    void Data(uint requestId, const QVariantMap &data);
+    void Log(uint requestId, int level, const QString &message);
 
 private Q_SLOTS:
     void remoteSignalReceived(int type, const QString &action, QByteArray blob);
+    void requestSignalReceived(uint requestId, int type, QByteArray blob);
+    void startedReceived(uint requestId);
+    void progressReceived(uint requestId, int percent);
+    void dataReceived(uint requestId, const QVariantMap &data);
+    void logReceived(uint requestId, int level, const QString &message);
+    void helperOwnerChanged(const QString &helperID);
 
 private:
-    bool isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details);
+    friend class DBusHelperControl;
+
+    // Looks up the unique name owning helperID, activating the helper first if needed
+    void resolveHelper(const QString &helperID, bool activate, const std::function<void(const QString &owner, const QString &error)> &callback);
+    // Calls back once the session with helperID is ready, right away for a helper that is known already
+    void withSession(const QString &helperID, const std::function<void(const QString &owner, const QString &error)> &callback);
+    void setupSession(const QString &helperID);
+    void finishSessionSetup(const QString &helperID, const QString &error);
+    // Unsubscribes from the helper's signals and forgets what is known about it
+    void resetSession(HelperSession &session);
+    // Sends the request once the session is ready. mayRetry allows sending it once more through
+    // helperID, should the helper have been gone before the request reached it.
+    void performWithSession(uint requestId, const QString &action, const QString &helperID, const QList<QVariant> &args, int timeout, bool mayRetry);
+    void sendPerformAction(uint requestId,
+                           const QString &action,
+                           const QString &helperID,
+                           const QString &owner,
+                           QList<QVariant> args,
+                           int timeout,
+                           bool mayRetry);
+    HelperSession *sessionForOwner(const QString &owner);
+    // The action of the request the signal being delivered is about, if it's one of ours
+    std::optional<QString> actionForSignal(uint requestId);
+    void handleRequestSignal(uint requestId, const QString &action, SignalType type, QByteArray blob);
+    // Stops the caller's request with the given id or, without an id, its requests for action
+    void requestStop(const QString &caller, uint requestId, const QString &action);
+    QByteArray handleRequest(const QString &action,
+                             const QByteArray &callerID,
+                             const QVariantMap &details,
+                             const QByteArray &arguments,
+                             const QMap<QString, QDBusUnixFileDescriptor> &fdArguments,
+                             uint requestId,
+                             bool replyWithSignal,
+                             bool cborReply,
+                             bool typedSignals);
+    // Asks the backend once the caller's credentials are known
+    QFuture<bool> authorizeRequest(const std::shared_ptr<Request> &request, const QByteArray &callerID, const QVariantMap &details);
+    // Waits for the credentials of request, parses them on first use
+    static HelperSupport::CallerCredentials requestCredentials(Request *request);
+    // Returns the reply if the slot answered right away, otherwise the request is answered once it does
+    std::optional<QByteArray> dispatchRequest(const std::shared_ptr<Request> &request,
+                                              const Invoker &invoker,
+                                              const QByteArray &arguments,
+                                              const QMap<QString, QDBusUnixFileDescriptor> &fdArguments);
+    void deferReply(Request *request);
+    QFuture<ActionReply> invokeResponder(Request *request, const Invoker &invoker, const QVariantMap &arguments);
+    void watchReply(const std::shared_ptr<Request> &request, const QFuture<ActionReply> &reply);
+    // The result of a finished slot future, or an error if it has none
+    static ActionReply replyOf(const QFuture<ActionReply> &future);
+    QByteArray finishRequest(const std::shared_ptr<Request> &request, const ActionReply &reply);
+    void emitRequestSignal(Request *request, SignalType type, const QByteArray &blob);
+    void sendRemoteSignal(const QString &caller, uint requestId, SignalType type, const QString &action, const QByteArray &blob);
+    // Sends one of the typed signals to the caller of request, with its id prepended to arguments
+    void emitTypedSignal(Request *request, const QString &name, const QVariantList &arguments);
+    QThreadPool *threadPool();
 };
 
 } // namespace Auth
@@ -50,19 +50,25 @@ bool FakeHelperProxy::initHelper(const QString &name)
     return false;
 }
 
-void FakeHelperProxy::stopAction(const QString &action, const QString &helperID)
+void FakeHelperProxy::stopAction(uint requestId, const QString &action, const QString &helperID)
 {
+    Q_UNUSED(requestId)
     Q_UNUSED(action)
     Q_UNUSED(helperID)
 }
 
-void FakeHelperProxy::executeAction(const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout)
+void FakeHelperProxy::executeAction(uint requestId,
+                                    const QString &action,
+                                    const QString &helperID,
+                                    const DetailsMap &details,
+                                    const QVariantMap &arguments,
+                                    int timeout)
 {
     Q_UNUSED(helperID)
     Q_UNUSED(details)
     Q_UNUSED(arguments)
     Q_UNUSED(timeout)
-    Q_EMIT actionPerformed(action, KAuth::ActionReply::NoSuchActionReply());
+    Q_EMIT actionPerformed(requestId, action, KAuth::ActionReply::NoSuchActionReply());
 }
 
 int FakeHelperProxy::callerUid() const
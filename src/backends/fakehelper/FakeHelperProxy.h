@@ -27,8 +27,13 @@ public:
     bool hasToStopAction() override;
     void setHelperResponder(QObject *o) override;
     bool initHelper(const QString &name) override;
-    void stopAction(const QString &action, const QString &helperID) override;
-    void executeAction(const QString &action, const QString &helperID, const DetailsMap &details, const QVariantMap &arguments, int timeout = -1) override;
+    void stopAction(uint requestId, const QString &action, const QString &helperID) override;
+    void executeAction(uint requestId,
+                       const QString &action,
+                       const QString &helperID,
+                       const DetailsMap &details,
+                       const QVariantMap &arguments,
+                       int timeout = -1) override;
     int callerUid() const override;
 };
 
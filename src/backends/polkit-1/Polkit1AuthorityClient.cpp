@@ -0,0 +1,250 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "Polkit1AuthorityClient.h"
+#include "FutureUtils.h"
+#include "kauthdebug.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QPromise>
+#include <QVersionNumber>
+
+#include <limits>
+#include <memory>
+
+constexpr QLatin1String c_polkitService{"org.freedesktop.PolicyKit1"};
+constexpr QLatin1String c_polkitPath{"/org/freedesktop/PolicyKit1/Authority"};
+constexpr QLatin1String c_polkitInterface{"org.freedesktop.PolicyKit1.Authority"};
+// Older releases insist on a start time for unix-process subjects
+constexpr int c_pidfdMinimumVersion = 123;
+// What polkit answers when it can't make sense of a subject
+constexpr QLatin1String c_polkitFailedError{"org.freedesktop.PolicyKit1.Error.Failed"};
+
+namespace KAuth
+{
+
+PolkitSubject PolkitSubject::systemBusName(const QString &name)
+{
+    return PolkitSubject{QStringLiteral("system-bus-name"), {{QStringLiteral("name"), name}}};
+}
+
+PolkitSubject PolkitSubject::unixProcess(const QDBusUnixFileDescriptor &pidfd, uint pid, int uid)
+{
+    return PolkitSubject{QStringLiteral("unix-process"),
+                         {
+                             {QStringLiteral("pidfd"), QVariant::fromValue(pidfd)},
+                             {QStringLiteral("pid"), pid},
+                             {QStringLiteral("uid"), uid},
+                         }};
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitSubject &subject)
+{
+    argument.beginStructure();
+    argument << subject.kind << subject.details;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitSubject &subject)
+{
+    argument.beginStructure();
+    argument >> subject.kind >> subject.details;
+    argument.endStructure();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitAuthorizationResult &result)
+{
+    argument.beginStructure();
+    argument << result.isAuthorized << result.isChallenge << result.details;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitAuthorizationResult &result)
+{
+    argument.beginStructure();
+    argument >> result.isAuthorized >> result.isChallenge >> result.details;
+    argument.endStructure();
+    return argument;
+}
+
+Polkit1AuthorityClient::Polkit1AuthorityClient(QObject *parent)
+    : QObject(parent)
+{
+    qDBusRegisterMetaType<QMap<QString, QString>>();
+    qDBusRegisterMetaType<PolkitSubject>();
+    qDBusRegisterMetaType<PolkitAuthorizationResult>();
+}
+
+QFuture<PolkitAuthorizationResult>
+Polkit1AuthorityClient::checkAuthorization(const PolkitSubject &subject, const QString &action, const QMap<QString, QString> &details, CheckFlag flags)
+{
+    QDBusMessage methodCall = QDBusMessage::createMethodCall(c_polkitService, c_polkitPath, c_polkitInterface, QStringLiteral("CheckAuthorization"));
+    methodCall << QVariant::fromValue(subject);
+    methodCall << action;
+    methodCall << QVariant::fromValue(details);
+    methodCall << static_cast<uint>(flags);
+    // Has to be unique among the pending checks of this connection
+    const QString cancellationId = QStringLiteral("kauth-%1").arg(++m_lastCancellationId);
+    methodCall << cancellationId;
+
+    // Checks allowing user interaction wait for the user to authenticate, don't time them out
+    const int timeout = flags & AllowUserInteraction ? std::numeric_limits<int>::max() : -1;
+
+    auto promise = std::make_shared<QPromise<PolkitAuthorizationResult>>();
+    promise->start();
+
+    // Canceling the future withdraws the check, polkit then answers the call with an error
+    onFutureCanceled(promise->future(), this, [this, cancellationId] {
+        cancelCheckAuthorization(cancellationId);
+    });
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(methodCall, timeout), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [watcher, promise, action] {
+        watcher->deleteLater();
+
+        QDBusPendingReply<PolkitAuthorizationResult> reply = *watcher;
+        PolkitAuthorizationResult result;
+        if (reply.isError()) {
+            qCDebug(KAUTH) << "Encountered error while checking authorization for" << action << reply.error().name() << reply.error().message();
+            result.error = reply.error().name();
+        } else {
+            result = reply.value();
+        }
+
+        promise->addResult(result);
+        promise->finish();
+    });
+
+    return promise->future();
+}
+
+struct Polkit1AuthorityClient::CallerCheck {
+    QString name;
+    QString action;
+    QMap<QString, QString> details;
+    CheckFlag flags;
+    QPromise<PolkitAuthorizationResult> promise;
+    QFuture<PolkitAuthorizationResult> pending; // the check polkit is working on, canceled along with promise
+};
+
+QFuture<PolkitAuthorizationResult> Polkit1AuthorityClient::checkCallerAuthorization(const QString &name,
+                                                                                    const std::optional<PolkitSubject> &process,
+                                                                                    const QString &action,
+                                                                                    const QMap<QString, QString> &details,
+                                                                                    CheckFlag flags)
+{
+    auto check = std::make_shared<CallerCheck>();
+    check->name = name;
+    check->action = action;
+    check->details = details;
+    check->flags = flags;
+    check->promise.start();
+
+    // Not known yet, the check only starts once the subject is
+    onFutureCanceled(check->promise.future(), this, [check]() {
+        check->pending.cancel();
+    });
+
+    if (!process) {
+        runCallerCheck(check, PolkitSubject::systemBusName(name));
+        return check->promise.future();
+    }
+
+    supportsPidfdSubjects().then(this, [this, check, process](bool supported) {
+        runCallerCheck(check, supported ? *process : PolkitSubject::systemBusName(check->name));
+    });
+
+    return check->promise.future();
+}
+
+void Polkit1AuthorityClient::runCallerCheck(const std::shared_ptr<CallerCheck> &check, const PolkitSubject &subject)
+{
+    // Given up on while the subject was looked up
+    if (check->promise.isCanceled()) {
+        check->promise.finish();
+        return;
+    }
+
+    check->pending = checkAuthorization(subject, check->action, check->details, check->flags);
+    check->pending
+        .then(this,
+              [this, check, subject](const PolkitAuthorizationResult &result) {
+                  if (result.error == c_polkitFailedError && subject.kind == QLatin1String("unix-process")) {
+                      // Not the polkit its version claims to be, don't try pidfds with it again
+                      qCDebug(KAUTH) << "polkit refused the unix-process subject of" << check->name << ", falling back to its bus name";
+                      m_pidfdSubjects = QtFuture::makeReadyValueFuture(false);
+                      runCallerCheck(check, PolkitSubject::systemBusName(check->name));
+                      return;
+                  }
+                  check->promise.addResult(result);
+                  check->promise.finish();
+              })
+        .onCanceled(this, [check]() {
+            check->promise.finish();
+        });
+}
+
+QFuture<bool> Polkit1AuthorityClient::supportsPidfdSubjects()
+{
+    if (m_pidfdSubjects) {
+        return *m_pidfdSubjects;
+    }
+
+    QDBusMessage methodCall =
+        QDBusMessage::createMethodCall(c_polkitService, c_polkitPath, QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("Get"));
+    methodCall << c_polkitInterface << QStringLiteral("BackendVersion");
+
+    auto promise = std::make_shared<QPromise<bool>>();
+    promise->start();
+    m_pidfdSubjects = promise->future();
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(methodCall), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [watcher, promise] {
+        watcher->deleteLater();
+
+        // Releases used to be numbered 0.x, e.g. 0.105, until they became 121
+        QDBusPendingReply<QDBusVariant> reply = *watcher;
+        const QVersionNumber version = reply.isError() ? QVersionNumber() : QVersionNumber::fromString(reply.value().variant().toString());
+        if (reply.isError()) {
+            qCDebug(KAUTH) << "Could not get the polkit version" << reply.error().message();
+        }
+
+        promise->addResult(version.majorVersion() >= c_pidfdMinimumVersion);
+        promise->finish();
+    });
+
+    return *m_pidfdSubjects;
+}
+
+void Polkit1AuthorityClient::cancelCheckAuthorization(const QString &cancellationId)
+{
+    QDBusMessage methodCall =
+        QDBusMessage::createMethodCall(c_polkitService, c_polkitPath, c_polkitInterface, QStringLiteral("CancelCheckAuthorization"));
+    methodCall << cancellationId;
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(methodCall), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [watcher, cancellationId] {
+        watcher->deleteLater();
+
+        QDBusPendingReply<> reply = *watcher;
+        if (reply.isError()) {
+            // Most likely the check was answered in the meantime
+            qCDebug(KAUTH) << "Could not cancel authorization check" << cancellationId << reply.error().message();
+        }
+    });
+}
+
+} // namespace KAuth
+
+#include "moc_Polkit1AuthorityClient.cpp"
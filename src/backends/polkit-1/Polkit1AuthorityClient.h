@@ -0,0 +1,92 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#ifndef POLKIT1AUTHORITYCLIENT_H
+#define POLKIT1AUTHORITYCLIENT_H
+
+#include <QDBusArgument>
+#include <QDBusUnixFileDescriptor>
+#include <QFuture>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+#include <memory>
+#include <optional>
+
+namespace KAuth
+{
+// A polkit subject as passed over the bus, e.g. ("system-bus-name", {"name": ":1.42"})
+struct PolkitSubject {
+    QString kind;
+    QVariantMap details;
+
+    static PolkitSubject systemBusName(const QString &name);
+    // Identifies the process by its pidfd, so that a recycled pid can't be mistaken for it
+    static PolkitSubject unixProcess(const QDBusUnixFileDescriptor &pidfd, uint pid, int uid);
+};
+
+struct PolkitAuthorizationResult {
+    bool isAuthorized = false;
+    bool isChallenge = false;
+    QMap<QString, QString> details;
+    // D-Bus error name, set when polkit could not be asked, the other members are meaningless then
+    QString error;
+};
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitSubject &subject);
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitSubject &subject);
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitAuthorizationResult &result);
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitAuthorizationResult &result);
+
+/*
+ * Talks to the polkit authority directly. Unlike PolkitQt1::Authority every call
+ * gets its own future and cancellation id, so any number of checks can be in flight
+ * at the same time and each one is answered with its own result. Canceling the
+ * future of a check withdraws it, closing the authentication dialog if one is open.
+ */
+class Polkit1AuthorityClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum CheckFlag {
+        NoFlags = 0,
+        AllowUserInteraction = 1,
+    };
+
+    explicit Polkit1AuthorityClient(QObject *parent = nullptr);
+
+    QFuture<PolkitAuthorizationResult>
+    checkAuthorization(const PolkitSubject &subject, const QString &action, const QMap<QString, QString> &details, CheckFlag flags);
+
+    // Same, for the process owning the system bus connection name. It's identified by the
+    // unix-process subject process when polkit supports pidfds, otherwise polkit resolves name itself.
+    QFuture<PolkitAuthorizationResult> checkCallerAuthorization(const QString &name,
+                                                                const std::optional<PolkitSubject> &process,
+                                                                const QString &action,
+                                                                const QMap<QString, QString> &details,
+                                                                CheckFlag flags);
+
+private:
+    struct CallerCheck;
+
+    void cancelCheckAuthorization(const QString &cancellationId);
+    // Whether polkit takes unix-process subjects without a start time, going by its version
+    QFuture<bool> supportsPidfdSubjects();
+    void runCallerCheck(const std::shared_ptr<CallerCheck> &check, const PolkitSubject &subject);
+
+    quint64 m_lastCancellationId = 0;
+    std::optional<QFuture<bool>> m_pidfdSubjects;
+};
+
+} // namespace KAuth
+
+Q_DECLARE_METATYPE(KAuth::PolkitSubject)
+Q_DECLARE_METATYPE(KAuth::PolkitAuthorizationResult)
+
+#endif
@@ -9,12 +9,15 @@
 */
 
 #include "Polkit1Backend.h"
+#include "FutureUtils.h"
 #include "kauthdebug.h"
 
 #include <KWaylandExtras>
 #include <KWindowSystem>
 
 #include <QCoreApplication>
+#include <QFutureWatcher>
+#include <QPromise>
 #include <QTimer>
 #include <qplugin.h>
 
@@ -22,17 +25,22 @@
 #include <QWindow>
 
 #include <QDBusConnection>
-#include <QDBusConnectionInterface>
 #include <QDBusPendingCallWatcher>
 #include <QDBusPendingReply>
 
 #include <PolkitQt1/Subject>
-#include <polkitqt1-version.h>
+
+#include <utility>
 
 constexpr QLatin1String c_kdeAgentService{"org.kde.polkit-kde-authentication-agent-1"};
 constexpr QLatin1String c_kdeAgentPath{"/org/kde/Polkit1AuthAgent"};
 constexpr QLatin1String c_kdeAgentInterface{"org.kde.Polkit1AuthAgent"};
 
+// Actions whose status is remembered, the least recently queried ones are dropped first
+constexpr int c_maxCachedResults = 256;
+// Installing a package usually changes several policy files in a row
+constexpr int c_recheckDelay = 250;
+
 namespace KAuth
 {
 
@@ -41,9 +49,95 @@ Polkit1Backend::Polkit1Backend()
 {
     setCapabilities(AuthorizeFromHelperCapability | PreAuthActionCapability);
 
+    m_cachedResults.setMaxCost(c_maxCachedResults);
+
+    m_recheckTimer.setSingleShot(true);
+    m_recheckTimer.setInterval(c_recheckDelay);
+    connect(&m_recheckTimer, &QTimer::timeout, this, &Polkit1Backend::recheckCachedResults);
+
     // Setup useful signals
     connect(PolkitQt1::Authority::instance(), &PolkitQt1::Authority::configChanged, this, &KAuth::Polkit1Backend::checkForResultChanged);
     connect(PolkitQt1::Authority::instance(), &PolkitQt1::Authority::consoleKitDBChanged, this, &KAuth::Polkit1Backend::checkForResultChanged);
+    connect(PolkitQt1::Authority::instance(), &PolkitQt1::Authority::configChanged, this, &KAuth::Polkit1Backend::clearAuthorizationCache);
+    connect(PolkitQt1::Authority::instance(), &PolkitQt1::Authority::consoleKitDBChanged, this, &KAuth::Polkit1Backend::clearAuthorizationCache);
+
+    // Only applications with a GUI pass windows to the agent, helpers don't even have a session bus
+    if (qGuiApp) {
+        watchAgent();
+    }
+}
+
+void Polkit1Backend::watchAgent()
+{
+    m_agentWatcher = new QDBusServiceWatcher(c_kdeAgentService, QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForOwnerChange, this);
+    connect(m_agentWatcher, &QDBusServiceWatcher::serviceOwnerChanged, this, [this](const QString &, const QString &, const QString &newOwner) {
+        if (newOwner.isEmpty()) {
+            setAgentState(AgentState::Absent);
+            return;
+        }
+        setAgentState(AgentState::Unknown);
+        probeAgent();
+    });
+
+    probeAgent();
+}
+
+void Polkit1Backend::probeAgent()
+{
+    // Tells both whether the agent is running and whether it's recent enough for window handles
+    QDBusMessage methodCall =
+        QDBusMessage::createMethodCall(c_kdeAgentService, c_kdeAgentPath, QStringLiteral("org.freedesktop.DBus.Introspectable"), QStringLiteral("Introspect"));
+    methodCall.setAutoStartService(false);
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(methodCall), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher] {
+        watcher->deleteLater();
+
+        QDBusPendingReply<QString> reply = *watcher;
+        if (reply.isError()) {
+            qCDebug(KAUTH) << "KDE polkit agent not reachable:" << reply.error().message();
+            setAgentState(AgentState::Absent);
+        } else if (reply.value().contains(QLatin1String("setWindowHandleForAction"))) {
+            setAgentState(AgentState::Current);
+        } else {
+            setAgentState(AgentState::Legacy);
+        }
+    });
+}
+
+void Polkit1Backend::setAgentState(AgentState state)
+{
+    m_agentState = state;
+    if (state == AgentState::Unknown) {
+        return;
+    }
+
+    // Handed over by preAuthAction() while the agent was probed
+    const auto pending = std::exchange(m_pendingWindowHandles, {});
+    for (const PendingWindowHandle &window : pending) {
+        deliverWindowHandle(window.action, window.handle, window.wId);
+    }
+}
+
+void Polkit1Backend::deliverWindowHandle(const QString &action, const QString &handle, std::optional<qulonglong> wId)
+{
+    switch (m_agentState) {
+    case AgentState::Unknown:
+        m_pendingWindowHandles.append({action, handle, wId});
+        break;
+    case AgentState::Current:
+        sendWindowHandle(action, handle);
+        break;
+    case AgentState::Legacy:
+        // Old agents only know about X11 window ids
+        if (wId) {
+            sendWindowId(action, *wId);
+        }
+        break;
+    case AgentState::Absent:
+        qCDebug(KAUTH) << "KDE polkit agent is not registered on the bus";
+        break;
+    }
 }
 
 Polkit1Backend::~Polkit1Backend()
@@ -64,11 +158,16 @@ void Polkit1Backend::preAuthAction(const QString &action, QWindow *parentWindow)
         return;
     }
 
-    // Are we running our KDE auth agent?
-    if (QDBusConnection::sessionBus().interface()->isServiceRegistered(QLatin1String("org.kde.polkit-kde-authentication-agent-1"))) {
+    if (!m_agentWatcher) {
+        // The application created its QGuiApplication after the backend
+        watchAgent();
+    }
+
+    // Are we running our KDE auth agent? Handles are held back until the probe tells which kind it is
+    if (m_agentState != AgentState::Absent) {
         if (KWindowSystem::isPlatformWayland()) {
             KWaylandExtras::exportToplevel(parentWindow).then(this, [this, action](const QString &handle) {
-                sendWindowHandle(action, handle);
+                deliverWindowHandle(action, handle, std::nullopt);
             });
 
             // Generate and send an XDG Activation token.
@@ -76,22 +175,10 @@ void Polkit1Backend::preAuthAction(const QString &action, QWindow *parentWindow)
         } else {
             // Retrieve the dialog root window Id
             const qulonglong wId = parentWindow->winId();
-
-            sendWindowHandle(action, QString::number(wId));
-
-            // Call the old method for compatibility.
-            QDBusMessage methodCall = QDBusMessage::createMethodCall(c_kdeAgentService, c_kdeAgentPath, c_kdeAgentInterface, QLatin1String("setWIdForAction"));
-            methodCall << action;
-            methodCall << wId;
-
-            // Legacy call has to be blocking, old agent doesn't handle it coming in delayed.
-            const auto reply = QDBusConnection::sessionBus().call(methodCall);
-            if (reply.type() != QDBusMessage::ReplyMessage) {
-                qWarning() << "Failed to set window id" << wId << "for" << action << reply.errorMessage();
-            }
+            deliverWindowHandle(action, QString::number(wId), wId);
         }
     } else {
-        qCDebug(KAUTH) << "KDE polkit agent appears too old or not registered on the bus";
+        qCDebug(KAUTH) << "KDE polkit agent is not registered on the bus";
     }
 }
 
@@ -114,6 +201,19 @@ void Polkit1Backend::sendWindowHandle(const QString &action, const QString &hand
     });
 }
 
+void Polkit1Backend::sendWindowId(const QString &action, qulonglong wId)
+{
+    QDBusMessage methodCall = QDBusMessage::createMethodCall(c_kdeAgentService, c_kdeAgentPath, c_kdeAgentInterface, QLatin1String("setWIdForAction"));
+    methodCall << action;
+    methodCall << wId;
+
+    // Legacy call has to be blocking, old agent doesn't handle it coming in delayed.
+    const auto reply = QDBusConnection::sessionBus().call(methodCall);
+    if (reply.type() != QDBusMessage::ReplyMessage) {
+        qWarning() << "Failed to set window id" << wId << "for" << action << reply.errorMessage();
+    }
+}
+
 void Polkit1Backend::sendActivationToken(const QString &action, QWindow *window)
 {
     const auto requestedSerial = KWaylandExtras::lastInputSerial(window);
@@ -149,10 +249,94 @@ Action::AuthStatus Polkit1Backend::authorizeAction(const QString &action)
 
 void Polkit1Backend::setupAction(const QString &action)
 {
-    m_cachedResults[action] = actionStatus(action);
+    // Seeds the cache without waiting for polkit. From then on recheckCachedResults() keeps the
+    // action up to date, also when it's only executed and nobody asks for its status.
+    if (m_cachedResults.contains(action) || m_pendingSetups.contains(action)) {
+        return;
+    }
+    m_pendingSetups.insert(action);
+
+    const PolkitSubject subject = PolkitSubject::systemBusName(QString::fromUtf8(callerID()));
+    m_authority.checkAuthorization(subject, action, {}, Polkit1AuthorityClient::NoFlags)
+        .then(this, [this, action](const PolkitAuthorizationResult &result) {
+            m_pendingSetups.remove(action);
+            // actionStatus() may have asked in the meantime, its answer is just as recent
+            if (!m_cachedResults.contains(action)) {
+                cacheResult(action, statusFromResult(result));
+            }
+        });
 }
 
 Action::AuthStatus Polkit1Backend::actionStatus(const QString &action)
+{
+    if (const Action::AuthStatus *status = m_cachedResults.object(action)) {
+        return *status;
+    }
+
+    const Action::AuthStatus status = checkActionStatus(action);
+    cacheResult(action, status);
+    return status;
+}
+
+void Polkit1Backend::cacheResult(const QString &action, Action::AuthStatus status)
+{
+    // Errors aren't remembered, polkit may well be reachable next time
+    if (status != Action::InvalidStatus) {
+        m_cachedResults.insert(action, new Action::AuthStatus(status));
+    }
+}
+
+QFuture<QHash<QString, Action::AuthStatus>> Polkit1Backend::actionStatuses(const QStringList &actions)
+{
+    struct PendingStatuses {
+        QPromise<QHash<QString, Action::AuthStatus>> promise;
+        QHash<QString, Action::AuthStatus> statuses;
+        qsizetype pending = 0;
+    };
+    auto pending = std::make_shared<PendingStatuses>();
+    pending->promise.start();
+
+    QStringList uncached;
+    for (const QString &action : actions) {
+        if (const Action::AuthStatus *status = m_cachedResults.object(action)) {
+            pending->statuses.insert(action, *status);
+        } else if (!uncached.contains(action)) {
+            uncached.append(action);
+        }
+    }
+
+    if (uncached.isEmpty()) {
+        pending->promise.addResult(pending->statuses);
+        pending->promise.finish();
+        return pending->promise.future();
+    }
+
+    // Ask polkit about all of them at once rather than waiting for each answer in turn
+    const PolkitSubject subject = PolkitSubject::systemBusName(QString::fromUtf8(callerID()));
+    pending->pending = uncached.size();
+    for (const QString &action : std::as_const(uncached)) {
+        m_authority.checkAuthorization(subject, action, {}, Polkit1AuthorityClient::NoFlags)
+            .then(this, [this, pending, action](const PolkitAuthorizationResult &result) {
+                const Action::AuthStatus status = statusFromResult(result);
+                cacheResult(action, status);
+                pending->statuses.insert(action, status);
+
+                if (--pending->pending == 0) {
+                    pending->promise.addResult(pending->statuses);
+                    pending->promise.finish();
+                }
+            });
+    }
+
+    return pending->promise.future();
+}
+
+void Polkit1Backend::invalidateActionStatus(const QString &action)
+{
+    m_cachedResults.remove(action);
+}
+
+Action::AuthStatus Polkit1Backend::checkActionStatus(const QString &action)
 {
     PolkitQt1::SystemBusNameSubject subject(QString::fromUtf8(callerID()));
     auto authority = PolkitQt1::Authority::instance();
@@ -175,6 +359,20 @@ Action::AuthStatus Polkit1Backend::actionStatus(const QString &action)
     }
 }
 
+Action::AuthStatus Polkit1Backend::statusFromResult(const PolkitAuthorizationResult &result)
+{
+    if (!result.error.isEmpty()) {
+        return Action::InvalidStatus;
+    }
+    if (result.isAuthorized) {
+        return Action::AuthorizedStatus;
+    }
+    if (result.isChallenge) {
+        return Action::AuthRequiredStatus;
+    }
+    return Action::DeniedStatus;
+}
+
 QByteArray Polkit1Backend::callerID() const
 {
     return QDBusConnection::systemBus().baseService().toUtf8();
@@ -182,48 +380,164 @@ QByteArray Polkit1Backend::callerID() const
 
 bool Polkit1Backend::isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details)
 {
-    PolkitQt1::SystemBusNameSubject subject(QString::fromUtf8(callerID));
-    PolkitQt1::Authority *authority = PolkitQt1::Authority::instance();
+    // Only this very check ends the wait, others may well finish in the meantime
+    const QFuture<bool> authorized = isCallerAuthorizedAsync(action, callerID, details, HelperSupport::CallerCredentials());
+    if (!authorized.isFinished()) {
+        QEventLoop e;
+        QFutureWatcher<bool> watcher;
+        connect(&watcher, &QFutureWatcherBase::finished, &e, &QEventLoop::quit);
+        watcher.setFuture(authorized);
+        e.exec();
+    }
+
+    return !authorized.isCanceled() && authorized.result();
+}
+
+QFuture<bool> Polkit1Backend::isCallerAuthorizedAsync(const QString &action,
+                                                      const QByteArray &callerID,
+                                                      const QVariantMap &details,
+                                                      const HelperSupport::CallerCredentials &credentials)
+{
+    const AuthorizationKey key{QString::fromUtf8(callerID), action, polkitDetails(details)};
+    if (hasCachedAuthorization(key)) {
+        return QtFuture::makeReadyValueFuture(true);
+    }
+
+    auto promise = std::make_shared<QPromise<bool>>();
+    promise->start();
+
+    // Without a pidfd polkit has to look the caller up by its bus name
+    std::optional<PolkitSubject> process;
+    if (credentials.pidfd() >= 0 && credentials.pid() >= 0 && credentials.uid() >= 0) {
+        process = PolkitSubject::unixProcess(QDBusUnixFileDescriptor(credentials.pidfd()), credentials.pid(), credentials.uid());
+    }
+
+    QFuture<PolkitAuthorizationResult> check =
+        m_authority.checkCallerAuthorization(key.caller, process, key.action, key.details, Polkit1AuthorityClient::AllowUserInteraction);
+
+    // Canceling the answer withdraws the check
+    forwardCancellation(promise->future(), this, check);
+
+    check
+        .then(this,
+              [this, key, promise](const PolkitAuthorizationResult &result) {
+                  const bool authorized = result.error.isEmpty() && result.isAuthorized;
+                  if (authorized) {
+                      cacheAuthorization(key);
+                  }
+                  promise->addResult(authorized);
+                  promise->finish();
+              })
+        .onCanceled(this, [promise]() {
+            promise->finish();
+        });
+
+    return promise->future();
+}
+
+QMap<QString, QString> Polkit1Backend::polkitDetails(const QVariantMap &details)
+{
     QMap<QString, QString> polkit1Details;
     for (auto it = details.cbegin(); it != details.cend(); ++it) {
         polkit1Details.insert(it.key(), it.value().toString());
     }
+    return polkit1Details;
+}
 
-    PolkitQt1::Authority::Result result;
-    QEventLoop e;
-    connect(authority, &PolkitQt1::Authority::checkAuthorizationFinished, &e, [&result, &e](PolkitQt1::Authority::Result _result) {
-        result = _result;
-        e.quit();
-    });
+bool Polkit1Backend::isCallerAuthorizationCached(const QString &action, const QByteArray &callerID, const QVariantMap &details)
+{
+    return hasCachedAuthorization(AuthorizationKey{QString::fromUtf8(callerID), action, polkitDetails(details)});
+}
 
-#if POLKITQT1_IS_VERSION(0, 113, 0)
-    authority->checkAuthorizationWithDetails(action, subject, PolkitQt1::Authority::AllowUserInteraction, polkit1Details);
-#else
-    authority->checkAuthorization(action, subject, PolkitQt1::Authority::AllowUserInteraction);
-#endif
-    e.exec();
+bool Polkit1Backend::hasCachedAuthorization(const AuthorizationKey &key) const
+{
+    if (m_authorizationCacheTimeout <= 0) {
+        return false;
+    }
 
-    if (authority->hasError()) {
-        qCDebug(KAUTH) << "Encountered error while checking authorization, error code:" << authority->lastError() << authority->errorDetails();
-        authority->clearError();
+    const auto it = m_authorizationCache.constFind(key);
+    return it != m_authorizationCache.cend() && !it->hasExpired();
+}
+
+void Polkit1Backend::cacheAuthorization(const AuthorizationKey &key)
+{
+    if (m_authorizationCacheTimeout <= 0) {
+        return;
     }
 
-    switch (result) {
-    case PolkitQt1::Authority::Yes:
-        return true;
-    default:
-        return false;
+    m_authorizationCache.insert(key, QDeadlineTimer(m_authorizationCacheTimeout));
+    m_callerWatcher->addWatchedService(key.caller);
+}
+
+void Polkit1Backend::setAuthorizationCacheTimeout(int msec)
+{
+    m_authorizationCacheTimeout = msec;
+    if (msec <= 0) {
+        clearAuthorizationCache();
+        return;
+    }
+
+    if (!m_callerWatcher) {
+        m_callerWatcher = new QDBusServiceWatcher(this);
+        m_callerWatcher->setConnection(QDBusConnection::systemBus());
+        m_callerWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+        connect(m_callerWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &Polkit1Backend::callerDisconnected);
+    }
+}
+
+void Polkit1Backend::clearAuthorizationCache()
+{
+    m_authorizationCache.clear();
+    if (m_callerWatcher) {
+        m_callerWatcher->setWatchedServices({});
     }
 }
 
+void Polkit1Backend::callerDisconnected(const QString &caller)
+{
+    // Unique names aren't reused, but drop the entries anyway so the cache doesn't grow with every client
+    m_authorizationCache.removeIf([&caller](decltype(m_authorizationCache)::iterator it) {
+        return it.key().caller == caller || it.value().hasExpired();
+    });
+    m_callerWatcher->removeWatchedService(caller);
+}
+
 void Polkit1Backend::checkForResultChanged()
 {
-    for (auto it = m_cachedResults.begin(); it != m_cachedResults.end(); ++it) {
-        const QString action = it.key();
-        if (it.value() != actionStatus(action)) {
-            *it = actionStatus(action);
-            Q_EMIT actionStatusChanged(action, *it);
-        }
+    m_recheckTimer.start();
+}
+
+void Polkit1Backend::recheckCachedResults()
+{
+    const quint64 generation = ++m_recheckGeneration;
+    const PolkitSubject subject = PolkitSubject::systemBusName(QString::fromUtf8(callerID()));
+
+    const QList<QString> actions = m_cachedResults.keys();
+    for (const QString &action : actions) {
+        m_authority.checkAuthorization(subject, action, {}, Polkit1AuthorityClient::NoFlags)
+            .then(this, [this, generation, action](const PolkitAuthorizationResult &result) {
+                if (generation != m_recheckGeneration) {
+                    return;
+                }
+
+                // Pruned or invalidated in the meantime, nobody is interested anymore
+                Action::AuthStatus *cached = m_cachedResults.object(action);
+                if (!cached) {
+                    return;
+                }
+
+                const Action::AuthStatus status = statusFromResult(result);
+                if (*cached == status) {
+                    return;
+                }
+
+                if (status == Action::InvalidStatus) {
+                    m_cachedResults.remove(action);
+                } else {
+                    *cached = status;
+                }
+                Q_EMIT actionStatusChanged(action, status);
+            });
     }
 }
 
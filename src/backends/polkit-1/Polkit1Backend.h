@@ -11,14 +11,21 @@
 #define POLKIT1BACKEND_H
 
 #include "AuthBackend.h"
+#include "Polkit1AuthorityClient.h"
 
+#include <QCache>
+#include <QDBusServiceWatcher>
+#include <QDeadlineTimer>
 #include <QEventLoop>
 #include <QHash>
+#include <QSet>
 #include <QStringList>
+#include <QTimer>
 
 #include <PolkitQt1/Authority>
 
 #include <memory>
+#include <optional>
 
 class QByteArray;
 
@@ -37,18 +44,86 @@ public:
     void preAuthAction(const QString &action, QWindow *parent) override;
     Action::AuthStatus authorizeAction(const QString &) override;
     Action::AuthStatus actionStatus(const QString &) override;
+    QFuture<QHash<QString, Action::AuthStatus>> actionStatuses(const QStringList &actions) override;
+    void invalidateActionStatus(const QString &action) override;
     QByteArray callerID() const override;
     bool isCallerAuthorized(const QString &action, const QByteArray &callerID, const QVariantMap &details) override;
+    QFuture<bool> isCallerAuthorizedAsync(const QString &action,
+                                          const QByteArray &callerID,
+                                          const QVariantMap &details,
+                                          const HelperSupport::CallerCredentials &credentials) override;
+    bool isCallerAuthorizationCached(const QString &action, const QByteArray &callerID, const QVariantMap &details) override;
+    void setAuthorizationCacheTimeout(int msec) override;
     QVariantMap backendDetails(const DetailsMap &details) override;
 
 private Q_SLOTS:
     void checkForResultChanged();
+    void recheckCachedResults();
+    void clearAuthorizationCache();
+    void callerDisconnected(const QString &caller);
+    void probeAgent();
 
 private:
+    Action::AuthStatus checkActionStatus(const QString &action);
+    static Action::AuthStatus statusFromResult(const PolkitAuthorizationResult &result);
+    void watchAgent();
+    // Sends the window handle the way the agent understands, once that is known. wId is only set on X11.
+    void deliverWindowHandle(const QString &action, const QString &handle, std::optional<qulonglong> wId);
     void sendWindowHandle(const QString &action, const QString &handle);
+    void sendWindowId(const QString &action, qulonglong wId);
     void sendActivationToken(const QString &action, QWindow *window);
 
-    QHash<QString, Action::AuthStatus> m_cachedResults;
+    void cacheResult(const QString &action, Action::AuthStatus status);
+
+    // What is known about the KDE authentication agent on the session bus
+    enum class AgentState {
+        Unknown, // not probed yet
+        Absent,
+        Legacy, // only knows setWIdForAction
+        Current, // takes window handles and activation tokens
+    };
+    void setAgentState(AgentState state);
+    AgentState m_agentState = AgentState::Unknown;
+    QDBusServiceWatcher *m_agentWatcher = nullptr;
+    struct PendingWindowHandle {
+        QString action;
+        QString handle;
+        std::optional<qulonglong> wId;
+    };
+    QList<PendingWindowHandle> m_pendingWindowHandles; // while m_agentState is Unknown
+
+    // Status of the recently used actions for this process, kept up to date by recheckCachedResults()
+    QCache<QString, Action::AuthStatus> m_cachedResults;
+    QSet<QString> m_pendingSetups; // actions setupAction() is still asking polkit about
+    // Coalesces bursts of polkit change notifications into a single recheck
+    QTimer m_recheckTimer;
+    // Bumped for every recheck, answers to an older one are dropped
+    quint64 m_recheckGeneration = 0;
+
+    // Granted authorizations of helper callers, only used when the helper opted in
+    struct AuthorizationKey {
+        QString caller;
+        QString action;
+        QMap<QString, QString> details;
+
+        bool operator==(const AuthorizationKey &other) const = default;
+        friend size_t qHash(const AuthorizationKey &key, size_t seed)
+        {
+            seed = qHashMulti(seed, key.caller, key.action);
+            for (auto it = key.details.cbegin(); it != key.details.cend(); ++it) {
+                seed = qHashMulti(seed, it.key(), it.value());
+            }
+            return seed;
+        }
+    };
+    static QMap<QString, QString> polkitDetails(const QVariantMap &details);
+    bool hasCachedAuthorization(const AuthorizationKey &key) const;
+    void cacheAuthorization(const AuthorizationKey &key);
+
+    QHash<AuthorizationKey, QDeadlineTimer> m_authorizationCache;
+    int m_authorizationCacheTimeout = 0;
+    QDBusServiceWatcher *m_callerWatcher = nullptr;
+    Polkit1AuthorityClient m_authority;
 };
 
 } // namespace Auth
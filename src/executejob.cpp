@@ -13,11 +13,18 @@
 #include <QEventLoop>
 #include <QGuiApplication>
 #include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QSet>
 #include <QTimer>
 #include <QWindow>
 
+#include <atomic>
+
 namespace KAuth
 {
+static std::atomic<uint> s_lastRequestId = 0;
+
 class ExecuteJobPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(KAuth::ExecuteJob)
@@ -30,6 +37,8 @@ public:
 
     ExecuteJob *q;
     Action action;
+    // Tells the replies for this job apart from the ones for other jobs running the same action
+    const uint requestId = ++s_lastRequestId;
 
     Action::ExecutionMode mode;
     QVariantMap data;
@@ -42,6 +51,112 @@ public:
     void statusChangedSlot(const QString &action, KAuth::Action::AuthStatus status);
 };
 
+// Routes the signals of the helper proxy and the auth backend straight to the running jobs they
+// are about, instead of every job looking at every signal
+class ExecuteJobDispatcher
+{
+public:
+    static ExecuteJobDispatcher &self()
+    {
+        static ExecuteJobDispatcher dispatcher;
+        return dispatcher;
+    }
+
+    void add(ExecuteJobPrivate *job)
+    {
+        HelperProxy *helper = BackendsManager::self().helperProxy();
+        AuthBackend *backend = BackendsManager::self().authBackend();
+
+        QMutexLocker locker(&m_mutex);
+        if (!m_proxies.contains(helper)) {
+            m_proxies.insert(helper);
+            connectProxy(helper);
+        }
+        if (m_backend != backend) {
+            m_backend = backend;
+            QObject::connect(backend, &AuthBackend::actionStatusChanged, backend, [this](const QString &action, Action::AuthStatus status) {
+                for (const auto &[job, q] : jobsForAction(action)) {
+                    invoke(job, q, [action, status](ExecuteJobPrivate *job) {
+                        job->statusChangedSlot(action, status);
+                    });
+                }
+            });
+        }
+
+        m_jobs.insert(job->requestId, job);
+        m_jobsByAction.insert(job->action.name(), job);
+    }
+
+    void remove(ExecuteJobPrivate *job)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_jobs.remove(job->requestId)) {
+            m_jobsByAction.remove(job->action.name(), job);
+        }
+    }
+
+private:
+    using JobRef = std::pair<ExecuteJobPrivate *, QPointer<ExecuteJob>>;
+
+    void connectProxy(HelperProxy *helper)
+    {
+        QObject::connect(helper, &HelperProxy::actionPerformed, helper, [this](uint requestId, const QString &action, const ActionReply &reply) {
+            const auto [job, q] = jobForRequest(requestId);
+            invoke(job, q, [action, reply](ExecuteJobPrivate *job) {
+                job->actionPerformedSlot(action, reply);
+            });
+        });
+        QObject::connect(helper, &HelperProxy::progressStep, helper, [this](uint requestId, const QString &action, int i) {
+            const auto [job, q] = jobForRequest(requestId);
+            invoke(job, q, [action, i](ExecuteJobPrivate *job) {
+                job->progressStepSlot(action, i);
+            });
+        });
+        QObject::connect(helper, &HelperProxy::progressStepData, helper, [this](uint requestId, const QString &action, const QVariantMap &data) {
+            const auto [job, q] = jobForRequest(requestId);
+            invoke(job, q, [action, data](ExecuteJobPrivate *job) {
+                job->progressStepSlot(action, data);
+            });
+        });
+    }
+
+    JobRef jobForRequest(uint requestId)
+    {
+        QMutexLocker locker(&m_mutex);
+        ExecuteJobPrivate *job = m_jobs.value(requestId);
+        return {job, job ? job->q : nullptr};
+    }
+
+    QList<JobRef> jobsForAction(const QString &action)
+    {
+        QMutexLocker locker(&m_mutex);
+        QList<JobRef> jobs;
+        for (auto it = m_jobsByAction.constFind(action); it != m_jobsByAction.cend() && it.key() == action; ++it) {
+            jobs.append({it.value(), it.value()->q});
+        }
+        return jobs;
+    }
+
+    // Calls into the job from its own thread, unless it's gone by then. Never called with the
+    // mutex held, since the job may remove itself right away.
+    template<typename Func>
+    static void invoke(ExecuteJobPrivate *job, const QPointer<ExecuteJob> &q, Func func)
+    {
+        if (!q) {
+            return;
+        }
+        QMetaObject::invokeMethod(q.data(), [job, func]() {
+            func(job);
+        });
+    }
+
+    QMutex m_mutex;
+    QHash<uint, ExecuteJobPrivate *> m_jobs; // by request id
+    QMultiHash<QString, ExecuteJobPrivate *> m_jobsByAction;
+    QSet<HelperProxy *> m_proxies;
+    AuthBackend *m_backend = nullptr;
+};
+
 static QWindow *parentWindow(const Action &action)
 {
     QWindow *window = action.parentWindow();
@@ -66,25 +181,12 @@ ExecuteJob::ExecuteJob(const Action &action, Action::ExecutionMode mode, QObject
 {
     d->action = action;
     d->mode = mode;
-
-    HelperProxy *helper = BackendsManager::self().helperProxy();
-
-    connect(helper, &KAuth::HelperProxy::actionPerformed, this, [this](const QString &action, const ActionReply &reply) {
-        d->actionPerformedSlot(action, reply);
-    });
-    connect(helper, &KAuth::HelperProxy::progressStep, this, [this](const QString &action, int i) {
-        d->progressStepSlot(action, i);
-    });
-    connect(helper, &KAuth::HelperProxy::progressStepData, this, [this](const QString &action, const QVariantMap &data) {
-        d->progressStepSlot(action, data);
-    });
-
-    connect(BackendsManager::self().authBackend(), &KAuth::AuthBackend::actionStatusChanged, this, [this](const QString &action, Action::AuthStatus status) {
-        d->statusChangedSlot(action, status);
-    });
 }
 
-ExecuteJob::~ExecuteJob() = default;
+ExecuteJob::~ExecuteJob()
+{
+    ExecuteJobDispatcher::self().remove(d.get());
+}
 
 Action ExecuteJob::action() const
 {
@@ -106,6 +208,8 @@ void ExecuteJob::start()
         return;
     }
 
+    ExecuteJobDispatcher::self().add(d.get());
+
     switch (d->mode) {
     case Action::ExecuteMode:
         QTimer::singleShot(0, this, [this]() {
@@ -128,7 +232,7 @@ void ExecuteJob::start()
 
 bool ExecuteJob::kill(KillVerbosity verbosity)
 {
-    BackendsManager::self().helperProxy()->stopAction(d->action.name(), d->action.helperId());
+    BackendsManager::self().helperProxy()->stopAction(d->requestId, d->action.name(), d->action.helperId());
     KJob::kill(verbosity);
     return true;
 }
@@ -145,7 +249,8 @@ void ExecuteJobPrivate::doExecuteAction()
 
         if (s == Action::AuthorizedStatus) {
             if (action.hasHelper()) {
-                BackendsManager::self().helperProxy()->executeAction(action.name(),
+                BackendsManager::self().helperProxy()->executeAction(requestId,
+                                                                     action.name(),
                                                                      action.helperId(),
                                                                      action.detailsV2(),
                                                                      action.arguments(),
@@ -184,7 +289,12 @@ void ExecuteJobPrivate::doExecuteAction()
             actionPerformedSlot(action.name(), r);
             return;
         }
-        BackendsManager::self().helperProxy()->executeAction(action.name(), action.helperId(), action.detailsV2(), action.arguments(), action.timeout());
+        BackendsManager::self().helperProxy()->executeAction(requestId,
+                                                             action.name(),
+                                                             action.helperId(),
+                                                             action.detailsV2(),
+                                                             action.arguments(),
+                                                             action.timeout());
     } else {
         // There's something totally wrong here
         ActionReply r(ActionReply::BackendError);
@@ -228,6 +338,8 @@ void ExecuteJobPrivate::doAuthorizeAction()
 void ExecuteJobPrivate::actionPerformedSlot(const QString &taction, const ActionReply &reply)
 {
     if (taction == action.name()) {
+        ExecuteJobDispatcher::self().remove(this);
+
         if (reply.failed()) {
             q->setError(reply.errorCode());
             q->setErrorText(reply.errorDescription());
@@ -150,9 +150,95 @@ bool HelperSupport::isStopped()
     return BackendsManager::self().helperProxy()->hasToStopAction();
 }
 
+int HelperSupport::stopFileDescriptor()
+{
+    return BackendsManager::self().helperProxy()->stopFileDescriptor();
+}
+
+void HelperSupport::setAuthorizationCacheTimeout(int msec)
+{
+    BackendsManager::self().authBackend()->setAuthorizationCacheTimeout(msec);
+}
+
 int HelperSupport::callerUid()
 {
     return BackendsManager::self().helperProxy()->callerUid();
 }
 
+HelperSupport::CallerCredentials HelperSupport::callerCredentials()
+{
+    return BackendsManager::self().helperProxy()->callerCredentials();
+}
+
+class HelperSupport::CallerCredentialsData : public QSharedData
+{
+public:
+    int uid = -1;
+    qint64 pid = -1;
+    QList<uint> gids;
+    int pidfd = -1;
+    QByteArray securityLabel;
+};
+
+HelperSupport::CallerCredentials::CallerCredentials()
+    : d(new CallerCredentialsData)
+{
+}
+
+HelperSupport::CallerCredentials::CallerCredentials(const CallerCredentials &other) = default;
+
+HelperSupport::CallerCredentials &HelperSupport::CallerCredentials::operator=(const CallerCredentials &other) = default;
+
+HelperSupport::CallerCredentials::~CallerCredentials() = default;
+
+int HelperSupport::CallerCredentials::uid() const
+{
+    return d->uid;
+}
+
+void HelperSupport::CallerCredentials::setUid(int uid)
+{
+    d->uid = uid;
+}
+
+qint64 HelperSupport::CallerCredentials::pid() const
+{
+    return d->pid;
+}
+
+void HelperSupport::CallerCredentials::setPid(qint64 pid)
+{
+    d->pid = pid;
+}
+
+QList<uint> HelperSupport::CallerCredentials::gids() const
+{
+    return d->gids;
+}
+
+void HelperSupport::CallerCredentials::setGids(const QList<uint> &gids)
+{
+    d->gids = gids;
+}
+
+int HelperSupport::CallerCredentials::pidfd() const
+{
+    return d->pidfd;
+}
+
+void HelperSupport::CallerCredentials::setPidfd(int pidfd)
+{
+    d->pidfd = pidfd;
+}
+
+QByteArray HelperSupport::CallerCredentials::securityLabel() const
+{
+    return d->securityLabel;
+}
+
+void HelperSupport::CallerCredentials::setSecurityLabel(const QByteArray &label)
+{
+    d->securityLabel = label;
+}
+
 } // namespace Auth
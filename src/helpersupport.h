@@ -8,7 +8,10 @@
 #ifndef KAUTH_HELPER_SUPPORT_H
 #define KAUTH_HELPER_SUPPORT_H
 
+#include <QByteArray>
+#include <QList>
 #include <QObject>
+#include <QSharedDataPointer>
 #include <QVariant>
 
 #include "kauthcore_export.h"
@@ -27,6 +30,30 @@
         return KAuth::HelperSupport::helperMain(argc, argv, ID, new HelperClass());                                                                            \
     }
 
+/*!
+ * Marks a responder slot to be run on a worker thread.
+ *
+ * By default the slots of the responder run on the helper's main thread, one at a time.
+ * Tag CPU-bound slots with this macro to run them on a bounded thread pool instead, so
+ * they don't hold up other callers of the helper. Replies and progress notifications are
+ * still sent from the main thread, and the HelperSupport functions work as usual.
+ * Adding \c{Q_CLASSINFO("KAuth.Threaded", "true")} to the responder class runs all of its
+ * slots that way.
+ *
+ * A threaded slot must be safe to run concurrently with the other slots and must not
+ * rely on objects living in the main thread.
+ *
+ * \code
+ * public Q_SLOTS:
+ *     KAUTH_THREADED ActionReply checksum(const QVariantMap &args);
+ * \endcode
+ *
+ * \since 6.29
+ */
+#ifndef Q_MOC_RUN
+#define KAUTH_THREADED
+#endif
+
 namespace KAuth
 {
 /*!
@@ -91,6 +118,20 @@ KAUTHCORE_EXPORT void progressStep(const QVariantMap &data);
  */
 KAUTHCORE_EXPORT bool isStopped();
 
+/*!
+ * \brief Obtains a file descriptor signalling that the caller asked to stop the current action
+ *
+ * The descriptor becomes readable once isStopped() would return \c true, so a slot waiting
+ * in poll() or select() on other descriptors can add it to the set instead of waking up
+ * regularly to call isStopped(). It belongs to the helper and is only valid until the
+ * slot returns: don't read from it or close it.
+ *
+ * Returns the file descriptor, or -1 when the backend or the platform doesn't support it
+ *
+ * \since 6.29
+ */
+KAUTHCORE_EXPORT int stopFileDescriptor();
+
 /*!
  * \brief Method that implements the main function of the helper tool. Do not call directly
  *
@@ -121,6 +162,111 @@ KAUTHCORE_EXPORT int helperMain(int argc, char **argv, const char *id, QObject *
  * Return caller UID or -1 when not available
  */
 KAUTHCORE_EXPORT int callerUid();
+
+class CallerCredentialsData;
+
+/*!
+ * \class KAuth::HelperSupport::CallerCredentials
+ * \inmodule KAuth
+ * \inheaderfile KAuth/HelperSupport
+ *
+ * \brief Credentials of the unprivileged process which asked for the current action
+ *
+ * Values which the backend can't determine keep their defaults. The setters are meant
+ * for the backends filling them in.
+ *
+ * \since 6.29
+ */
+class KAUTHCORE_EXPORT CallerCredentials
+{
+public:
+    /*!
+     * Constructs credentials with none of the values known
+     */
+    CallerCredentials();
+    CallerCredentials(const CallerCredentials &other);
+    CallerCredentials &operator=(const CallerCredentials &other);
+    ~CallerCredentials();
+
+    /*!
+     * Returns the user id of the process, or -1
+     */
+    int uid() const;
+    /*!
+     * Sets the user id of the process to \a uid
+     */
+    void setUid(int uid);
+
+    /*!
+     * Returns the process id, or -1
+     */
+    qint64 pid() const;
+    /*!
+     * Sets the process id to \a pid
+     */
+    void setPid(qint64 pid);
+
+    /*!
+     * Returns the group ids of the process
+     */
+    QList<uint> gids() const;
+    /*!
+     * Sets the group ids of the process to \a gids
+     */
+    void setGids(const QList<uint> &gids);
+
+    /*!
+     * Returns a pidfd referring to the process, or -1. It belongs to the helper and is only
+     * valid until the slot returns: don't close it.
+     */
+    int pidfd() const;
+    /*!
+     * Sets the pidfd referring to the process to \a pidfd. The caller keeps owning it.
+     */
+    void setPidfd(int pidfd);
+
+    /*!
+     * Returns the security label of the process, e.g. its SELinux context or AppArmor profile
+     */
+    QByteArray securityLabel() const;
+    /*!
+     * Sets the security label of the process to \a label
+     */
+    void setSecurityLabel(const QByteArray &label);
+
+private:
+    QSharedDataPointer<CallerCredentialsData> d;
+};
+
+/*!
+ * \brief Obtains the credentials of the process which asked for the current action
+ *
+ * The credentials are looked up once per action, calling this function repeatedly is cheap.
+ * callerUid() returns the uid() of the result.
+ *
+ * \since 6.29
+ */
+KAUTHCORE_EXPORT CallerCredentials callerCredentials();
+
+/*!
+ * \brief Lets the helper remember granted authorizations for a short time
+ *
+ * By default every action performed by the helper is authorized with the
+ * authorization backend on its own. A helper receiving many calls in a row from
+ * the same client can allow the backend to remember for \a msec milliseconds that
+ * a caller was authorized to perform an action with the given details.
+ *
+ * Only granted authorizations are remembered. They are forgotten when the caller
+ * disconnects or the authorization policy changes. Pass 0 to stop remembering them.
+ *
+ * Keep \a msec short: a remembered authorization is honoured even if it would
+ * have expired in the authorization system in the meantime.
+ *
+ * Backends which can't remember authorizations ignore this.
+ *
+ * \since 6.29
+ */
+KAUTHCORE_EXPORT void setAuthorizationCacheTimeout(int msec);
 } // namespace HelperSupport
 
 } // namespace Auth